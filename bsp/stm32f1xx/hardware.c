@@ -26,8 +26,16 @@ extern vector_table_t vector_table;
 void *hw_memory_bgn = NULL;
 void *hw_memory_end = NULL;
 
+#define SYSTICK_CYCLES      (72000000 / SYSTEM_TICKS_PRE_SEC)
+#define SYSTICK_STEP_MAX    (STK_RVR_RELOAD / SYSTICK_CYCLES)
+#define SYSTICK_REST_MIN    (64)
+
 static int8_t reset_flags = 0;
 
+/* Ticks of the coming systick interrupt, more than 1 in idle */
+static volatile uint32_t systick_step = 1;
+static volatile uint8_t  systick_restore = 0;
+
 static void hw_setup_memory(void)
 {
     hw_memory_bgn = CUPKEE_ADDR_ALIGN(&end, 16);
@@ -36,7 +44,8 @@ static void hw_setup_memory(void)
 
 static void hw_setup_systick(void)
 {
-    systick_set_frequency(SYSTEM_TICKS_PRE_SEC, 72000000);
+    systick_set_clocksource(STK_CSR_CLKSOURCE_AHB);
+    systick_set_reload(SYSTICK_CYCLES - 1);
 
     systick_interrupt_enable();
     systick_counter_enable();
@@ -76,10 +85,87 @@ static void hw_reset_probe(void)
 /* systick interrupt handle routing  */
 void sys_tick_handler(void)
 {
-    _cupkee_systicks++;
+    _cupkee_systicks += systick_step;
+
+    if (systick_restore) {
+        // Back to one tick a period, from now
+        systick_set_reload(SYSTICK_CYCLES - 1);
+        systick_clear();
+        systick_step = 1;
+        systick_restore = 0;
+    }
+
     cupkee_event_post_systick();
 }
 
+/* Stretch systick period to the deadline and wait for interrupt.
+ * Woken up by others before that, ticks passed are added to systicks
+ * and systick is set to fire at the next tick boundary.
+ */
+void hw_idle(uint32_t until)
+{
+    uint32_t state, ticks, first, load;
+
+    hw_enter_critical(&state);
+
+    // Systick pending, ticks is not updated yet
+    ticks = until - _cupkee_systicks;
+    if ((int32_t)ticks <= 0 || (SCB_ICSR & SCB_ICSR_PENDSTSET) || cupkee_event_pending()) {
+        hw_exit_critical(state);
+        return;
+    }
+
+    first = 0;
+    load = 0;
+    if (ticks > 1) {
+        if (ticks > SYSTICK_STEP_MAX) {
+            ticks = SYSTICK_STEP_MAX;
+        }
+
+        first = systick_get_value();  // cycles to the next tick
+        load = first + (ticks - 1) * SYSTICK_CYCLES;
+        systick_set_reload(load - 1);
+        systick_clear();
+        (void) systick_get_countflag();
+
+        systick_step = ticks;
+        systick_restore = 1;
+    }
+
+    hw_idle_usb();
+    __asm__ volatile ("wfi");
+
+    if (load) {
+        uint32_t passed = load - 1 - systick_get_value();
+
+        // Not woken by systick: count ticks passed, wait the next boundary
+        if (!systick_get_countflag()) {
+            uint32_t rest;
+
+            if (passed < first) {
+                ticks = 0;
+                rest = first - passed;
+            } else {
+                passed -= first;
+                ticks = 1 + passed / SYSTICK_CYCLES;
+                rest = SYSTICK_CYCLES - passed % SYSTICK_CYCLES;
+            }
+            // Too close to boundary to set as reload, take the tick now
+            if (rest < SYSTICK_REST_MIN) {
+                ticks++;
+                rest += SYSTICK_CYCLES;
+            }
+
+            _cupkee_systicks += ticks;
+            systick_set_reload(rest - 1);
+            systick_clear();
+            systick_step = 1;
+        }
+    }
+
+    hw_exit_critical(state);
+}
+
 size_t hw_memory_size(void)
 {
     return hw_memory_end - hw_memory_bgn;
@@ -129,6 +215,16 @@ void hw_cuid_get(uint8_t *cuid)
     memcpy(cuid, buf, 12);
 }
 
+uint32_t hw_cycle_count(void)
+{
+    return dwt_read_cycle_counter();
+}
+
+uint32_t hw_cycle_freq(void)
+{
+    return 72000000;
+}
+
 void hw_info_get(hw_info_t *info)
 {
     info->sys_freq = 72000000;
@@ -151,6 +247,7 @@ void hw_setup(hw_info_t *info)
     hw_setup_timer();
     hw_setup_storage();
     hw_setup_systick();
+    dwt_enable_cycle_counter();
 
     hw_info_get(info);
 }
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <libopencm3/cm3/systick.h>
+#include <libopencm3/cm3/dwt.h>
 #include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/cm3/vector.h>
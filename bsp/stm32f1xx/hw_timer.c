@@ -34,6 +34,13 @@ static const uint32_t device_base[] = {TIM2, TIM3, TIM4, TIM5};
 static const uint32_t device_rcc[] = {RCC_TIM2, RCC_TIM3, RCC_TIM4, RCC_TIM5};
 static const uint32_t device_irq[] = {NVIC_TIM2_IRQ, NVIC_TIM3_IRQ, NVIC_TIM4_IRQ, NVIC_TIM5_IRQ};
 
+/* High resolution timer: one instance free running at 1us, extended to 32
+ * bits by overflow count, and compare channel 1 as alarm */
+static int8_t   hrtimer_inst = -1;
+static uint8_t  hrtimer_armed = 0;
+static uint32_t hrtimer_at;
+static volatile uint32_t hrtimer_hi;    // overflow count << 16
+
 static inline hw_timer_t *hw_device(unsigned id) {
     if (id < HW_TIMER_NUM) {
         return &device_controls[id];
@@ -167,12 +174,149 @@ void hw_setup_timer(void)
         device_controls[i].inused = 0;
         device_controls[i].timer_id = -1;
     }
+    hrtimer_inst = -1;
+}
+
+static inline int hrtimer_compare_set(uint32_t base)
+{
+    TIM_CCR1(base) = hrtimer_at & 0xFFFF;
+    TIM_SR(base) = ~TIM_SR_CC1IF;
+    TIM_DIER(base) |= TIM_DIER_CC1IE;
+
+    // Counter may pass the compare value already
+    if ((int32_t)(hrtimer_at - hw_hrtimer_now()) <= 0 && !(TIM_SR(base) & TIM_SR_CC1IF)) {
+        TIM_DIER(base) &= ~TIM_DIER_CC1IE;
+        hrtimer_armed = 0;
+        return -CUPKEE_ETIMEOUT;
+    }
+    return 0;
+}
+
+int hw_hrtimer_setup(void)
+{
+    uint32_t base;
+    int inst;
+
+    if (hrtimer_inst >= 0) {
+        return 0;
+    }
+
+    inst = hw_timer_alloc();
+    if (inst < 0) {
+        return -CUPKEE_ERESOURCE;
+    }
+    base = device_base[inst];
+
+    TIM_CR1(base) = 0;
+    TIM_CNT(base) = 0;
+    TIM_PSC(base) = 71; // 1 us
+    TIM_ARR(base) = 0xFFFF;
+    TIM_CCMR1(base) = 0;
+    TIM_EGR(base) = TIM_EGR_UG;
+    TIM_SR(base) = 0;
+    TIM_DIER(base) = TIM_DIER_UIE;
+
+    hrtimer_hi = 0;
+    hrtimer_armed = 0;
+    hrtimer_inst = inst;
+
+    nvic_enable_irq(device_irq[inst]);
+    TIM_CR1(base) = TIM_CR1_CEN;
+
+    return 0;
+}
+
+uint32_t hw_hrtimer_now(void)
+{
+    uint32_t base, state, hi, cnt;
+
+    if (hrtimer_inst < 0) {
+        return 0;
+    }
+    base = device_base[hrtimer_inst];
+
+    hw_enter_critical(&state);
+    hi = hrtimer_hi;
+    cnt = TIM_CNT(base);
+    // Overflow not counted by interrupt yet
+    if ((TIM_SR(base) & TIM_SR_UIF) && cnt < 0x8000) {
+        hi += 0x10000;
+    }
+    hw_exit_critical(state);
+
+    return hi | cnt;
+}
+
+int hw_hrtimer_alarm(uint32_t at)
+{
+    uint32_t base = device_base[hrtimer_inst];
+    uint32_t state;
+    int err = 0;
+
+    hw_enter_critical(&state);
+
+    hrtimer_at = at;
+    hrtimer_armed = 1;
+    TIM_DIER(base) &= ~TIM_DIER_CC1IE;
+
+    if ((int32_t)(at - hw_hrtimer_now()) <= 0) {
+        hrtimer_armed = 0;
+        err = -CUPKEE_ETIMEOUT;
+    } else
+    if (at - hw_hrtimer_now() < 0x10000) {
+        err = hrtimer_compare_set(base);
+    }
+    // else: compare is set by overflow interrupt, when it come near
+
+    hw_exit_critical(state);
+
+    return err;
+}
+
+void hw_hrtimer_cancel(void)
+{
+    if (hrtimer_inst >= 0) {
+        hrtimer_armed = 0;
+        TIM_DIER(device_base[hrtimer_inst]) &= ~TIM_DIER_CC1IE;
+    }
+}
+
+static inline void hrtimer_isr(uint32_t base)
+{
+    uint32_t sr = TIM_SR(base);
+    int expired = 0;
+
+    if (sr & TIM_SR_UIF) {
+        TIM_SR(base) = ~TIM_SR_UIF;
+        hrtimer_hi += 0x10000;
+
+        if (hrtimer_armed && !(TIM_DIER(base) & TIM_DIER_CC1IE)
+            && hrtimer_at - hrtimer_hi < 0x10000) {
+            expired = hrtimer_compare_set(base);
+        }
+    }
+
+    if ((sr & TIM_SR_CC1IF) && (TIM_DIER(base) & TIM_DIER_CC1IE)) {
+        TIM_SR(base) = ~TIM_SR_CC1IF;
+        TIM_DIER(base) &= ~TIM_DIER_CC1IE;
+        hrtimer_armed = 0;
+        expired = 1;
+    }
+
+    if (expired) {
+        cupkee_hrtimer_expire();
+    }
 }
 
 static inline void timer_isr(int x) {
     hw_timer_t *timer = hw_device(x);
     uint32_t    base = device_base[x];
 
+    if (x == hrtimer_inst) {
+        hrtimer_isr(base);
+        return;
+    }
+
     TIM_SR(base) &= ~TIM_SR_UIF;
     if (timer->inused) {
         if (timer->ccr_x) {
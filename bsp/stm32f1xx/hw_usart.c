@@ -307,6 +307,14 @@ static const cupkee_struct_desc_t conf_desc[] = {
         .name = "stopbits",
         .type = CUPKEE_STRUCT_UINT8
     },
+    {
+        .name = "rxbuffer",
+        .type = CUPKEE_STRUCT_UINT16
+    },
+    {
+        .name = "txbuffer",
+        .type = CUPKEE_STRUCT_UINT16
+    },
 };
 
 static cupkee_struct_t *uart_conf_init(void *curr)
@@ -316,7 +324,7 @@ static cupkee_struct_t *uart_conf_init(void *curr)
     if (curr) {
         conf = curr;
     } else {
-        conf = cupkee_struct_alloc(4, conf_desc);
+        conf = cupkee_struct_alloc(6, conf_desc);
     }
 
     if (conf) {
@@ -324,6 +332,8 @@ static cupkee_struct_t *uart_conf_init(void *curr)
         cupkee_struct_set_uint(conf, 1, 8);
         cupkee_struct_set_string(conf, 2, "None");
         cupkee_struct_set_uint(conf, 3, 1);
+        cupkee_struct_set_uint(conf, 4, 0);
+        cupkee_struct_set_uint(conf, 5, 0);
     }
 
     return conf;
@@ -344,7 +354,10 @@ static const cupkee_device_desc_t hw_device_uart = {
     .name = "uart",
     .inst_max = USART_MAX,
     .conf_init = uart_conf_init,
-    .driver = &uart_driver
+    .driver = &uart_driver,
+    // 921600 baud fill about 92 bytes per ms
+    .rx_size = 128,
+    .tx_size = 64
 };
 
 void hw_setup_usart(void)
@@ -395,3 +395,17 @@ void hw_poll_usb(void)
     usbd_poll(usb_hnd);
 }
 
+/* USB is polled in main loop, the interrupt is enabled only to wake up
+ * from idle, and masked again once taken.
+ */
+void hw_idle_usb(void)
+{
+    nvic_clear_pending_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+    nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+}
+
+void usb_lp_can_rx0_isr(void)
+{
+    nvic_disable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+}
+
@@ -23,6 +23,7 @@
 
 void hw_setup_usb(void);
 void hw_poll_usb(void);
+void hw_idle_usb(void);
 
 #endif /* __HW_USB_INC__ */
 
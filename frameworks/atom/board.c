@@ -29,6 +29,10 @@ static const native_t board_entries[] = {
     /* Cupkee natives */
     {"sysinfos",        native_sysinfos},
     {"systicks",        native_systicks},
+    {"meminfo",         native_meminfo},
+    {"memtrace",        native_memtrace},
+    {"eventinfo",       native_eventinfo},
+    {"loopinfo",        native_loopinfo},
     {"require",         native_require},
     {"report",          native_report},
     {"interface",       native_interface},
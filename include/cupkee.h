@@ -30,12 +30,15 @@
 #include "cupkee_utils.h"
 #include "cupkee_data.h"
 #include "cupkee_memory.h"
+#include "cupkee_pool.h"
+#include "cupkee_arena.h"
 #include "cupkee_buffer.h"
 #include "cupkee_storage.h"
 #include "cupkee_event.h"
+#include "cupkee_meter.h"
 #include "cupkee_vector.h"
-#include "cupkee_stream.h"
 #include "cupkee_block.h"
+#include "cupkee_stream.h"
 #include "cupkee_process.h"
 #include "cupkee_struct.h"
 #include "cupkee_object.h"
@@ -44,6 +47,7 @@
 
 #include "cupkee_pin.h"
 #include "cupkee_timer.h"
+#include "cupkee_hrtimer.h"
 
 #include "cupkee_timeout.h"
 #include "cupkee_device.h"
@@ -54,7 +58,10 @@
 
 void cupkee_init(const uint8_t *id);
 void cupkee_loop(void);
-void cupkee_event_poll(void);
+/* Dispatch events pending, return number of event dispatched */
+int  cupkee_event_poll(void);
+/* Sleep till the next deadline of timeout or device, if nothing pending */
+void cupkee_idle(void);
 
 static inline void cupkee_start(void) {
     _cupkee_systicks = 0;
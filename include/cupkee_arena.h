@@ -0,0 +1,50 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#ifndef __CUPKEE_ARENA_INC__
+#define __CUPKEE_ARENA_INC__
+
+/* Bump allocator for memory used in a request or an event only:
+ * blocks can not be freed one by one, but all at once by reset,
+ * or those allocated after a mark by rewind.
+ * Pages are taken from the buddy system and chained by their list head.
+ */
+typedef struct cupkee_arena_t {
+    list_head_t pages;      // newest page first
+    uint8_t *pos;
+    uint8_t *end;
+} cupkee_arena_t;
+
+typedef struct cupkee_arena_mark_t {
+    cupkee_page_t *page;
+    uint8_t *pos;
+} cupkee_arena_mark_t;
+
+void  cupkee_arena_init(cupkee_arena_t *arena);
+void *cupkee_arena_alloc(cupkee_arena_t *arena, size_t size);
+
+/* Drop everything, the first page is kept for next use */
+void  cupkee_arena_reset(cupkee_arena_t *arena);
+/* Drop everything and give all pages back */
+void  cupkee_arena_release(cupkee_arena_t *arena);
+
+void  cupkee_arena_mark(cupkee_arena_t *arena, cupkee_arena_mark_t *mark);
+void  cupkee_arena_rewind(cupkee_arena_t *arena, const cupkee_arena_mark_t *mark);
+
+#endif /* __CUPKEE_ARENA_INC__ */
@@ -20,6 +20,99 @@
 #ifndef __CUPKEE_BLOCK_INC__
 #define __CUPKEE_BLOCK_INC__
 
+/* Block of data, handed over between driver and user of stream with
+ * its ownership, so a whole packet is passed without copy.
+ *
+ * Blocks of CUPKEE_BLOCK_POOL_SIZE bytes at most are taken from a pool
+ * preallocated by cupkee_block_setup, which is safe in interrupt. Bigger
+ * blocks, or small ones when the pool is used up, come from heap: they are
+ * allocated and released in main loop only.
+ */
+typedef struct cupkee_block_t {
+    struct cupkee_block_t *next;
+    uint16_t cap;
+    uint16_t bgn;
+    uint16_t len;
+    uint16_t flags;
+    uint8_t  data[0];
+} cupkee_block_t;
+
+#define CUPKEE_BLOCK_FL_POOL    0x0001
+
+typedef struct cupkee_block_queue_t {
+    cupkee_block_t *head;
+    cupkee_block_t *tail;
+    size_t bytes;
+} cupkee_block_queue_t;
+
+int   cupkee_block_setup(void);
+
+/* Main loop only */
+void *cupkee_block_alloc(size_t size);
+void *cupkee_block_create(size_t n, const void *data);
+
+/* Safe in interrupt, NULL if pool is used up */
+void *cupkee_block_alloc_pooled(void);
+
+/* Safe in interrupt for pooled block, main loop only for the others */
+void  cupkee_block_release(void *b);
+
+static inline int cupkee_block_is_pooled(void *b) {
+    return ((cupkee_block_t *)b)->flags & CUPKEE_BLOCK_FL_POOL;
+}
+
+static inline void *cupkee_block_ptr(void *b) {
+    cupkee_block_t *blk = b;
+    return blk->data + blk->bgn;
+}
+
+static inline size_t cupkee_block_length(void *b) {
+    return ((cupkee_block_t *)b)->len;
+}
+
+static inline size_t cupkee_block_capacity(void *b) {
+    return ((cupkee_block_t *)b)->cap;
+}
+
+static inline int cupkee_block_set_length(void *b, size_t n) {
+    cupkee_block_t *blk = b;
+
+    if (n > (size_t)(blk->cap - blk->bgn)) {
+        return -CUPKEE_EINVAL;
+    }
+    blk->len = n;
+    return n;
+}
+
+/* Queue is shared between interrupt and main loop, one side produces and
+ * the other consumes, every change of the links is in critical section.
+ */
+static inline void cupkee_block_queue_init(cupkee_block_queue_t *q) {
+    q->head = NULL;
+    q->tail = NULL;
+    q->bytes = 0;
+}
+
+static inline size_t cupkee_block_queue_bytes(cupkee_block_queue_t *q) {
+    return q->bytes;
+}
+
+static inline int cupkee_block_queue_is_empty(cupkee_block_queue_t *q) {
+    return q->head == NULL;
+}
+
+void  cupkee_block_queue_push(cupkee_block_queue_t *q, void *b);
+void *cupkee_block_queue_pop(cupkee_block_queue_t *q);
+/* Copy in n bytes at most, into free space of the tail block and then into
+ * pooled blocks, never touch heap. Return bytes accepted
+ */
+int   cupkee_block_queue_give(cupkee_block_queue_t *q, size_t n, const void *data);
+/* Copy out n bytes at most. Blocks drained are released, except heap blocks
+ * if done is given: they are moved to done, to be released in main loop
+ */
+int   cupkee_block_queue_take(cupkee_block_queue_t *q, size_t n, void *buf, cupkee_block_queue_t *done);
+/* Main loop only */
+void  cupkee_block_queue_clear(cupkee_block_queue_t *q);
 
 #endif /* __CUPKEE_BLOCK_INC__ */
 
@@ -71,6 +71,15 @@ void hw_exit_critical(uint32_t state);
 void hw_cuid_get(uint8_t *cuid);
 void hw_info_get(hw_info_t *);
 
+/* Sleep till systicks reach until, or woken by any interrupt. Should return
+ * at once if any event pending, checked with interrupt disabled.
+ */
+void hw_idle(uint32_t until);
+
+/* Free running high resolution counter, wrap around at 32 bits */
+uint32_t hw_cycle_count(void);
+uint32_t hw_cycle_freq(void);
+
 /* MEMORY */
 void  *hw_memory_alloc(size_t size, size_t align);
 size_t hw_memory_size(void);
@@ -98,6 +107,15 @@ int hw_timer_stop(int inst);
 int hw_timer_update(int inst, int us);
 int hw_timer_duration_get(int inst);
 
+/* HRTIMER: one hardware timer run as 32 bits, 1us free running counter,
+ * with an alarm to call cupkee_hrtimer_expire in interrupt.
+ * hw_hrtimer_alarm return -CUPKEE_ETIMEOUT if at is passed already.
+ */
+int      hw_hrtimer_setup(void);
+uint32_t hw_hrtimer_now(void);
+int      hw_hrtimer_alarm(uint32_t at);
+void     hw_hrtimer_cancel(void);
+
 /* DEVICE */
 int hw_device_setup(void);
 int hw_device_setup_noirq(void);
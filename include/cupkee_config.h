@@ -22,10 +22,107 @@
 
 // Device
 #define CUPKEE_DEVICE_TYPE_MAX          16
+// Stream buffer size of device, if not given by descriptor or "rxbuffer" &
+// "txbuffer" item of config
+#ifndef CUPKEE_DEVICE_STREAM_SIZE
+#define CUPKEE_DEVICE_STREAM_SIZE       (32)
+#endif
+#ifndef CUPKEE_DEVICE_STREAM_SIZE_MAX
+#define CUPKEE_DEVICE_STREAM_SIZE_MAX   (4096)
+#endif
+
+// Blocks preallocated for stream, to queue data from driver without heap
+#ifndef CUPKEE_BLOCK_POOL_SIZE
+#define CUPKEE_BLOCK_POOL_SIZE          (64)
+#endif
+#ifndef CUPKEE_BLOCK_POOL_NUM
+#define CUPKEE_BLOCK_POOL_NUM           (8)
+#endif
+
+// Event queue, depth and coalesce flags used by cupkee_init
+#ifndef CUPKEE_EVENTQ_SIZE
+#define CUPKEE_EVENTQ_SIZE              (16)
+#endif
+#ifndef CUPKEE_EVENTQ_HIGH_SIZE
+#define CUPKEE_EVENTQ_HIGH_SIZE         (8)
+#endif
+#ifndef CUPKEE_EVENTQ_HIGH_BURST
+#define CUPKEE_EVENTQ_HIGH_BURST        (16)
+#endif
+#ifndef CUPKEE_EVENTQ_FLAGS
+#define CUPKEE_EVENTQ_FLAGS             (CUPKEE_EVENTQ_COALESCE_SYSTICK)
+#endif
+// Events taken from queue at once by cupkee_event_poll
+#ifndef CUPKEE_EVENT_BATCH
+#define CUPKEE_EVENT_BATCH              (8)
+#endif
+// Post & take event without masking interrupt, depth is rounded up to
+// power of 2. Set 0 on core without exclusive access (cortex-m0), then
+// queue is protected by critical section.
+#ifndef CUPKEE_EVENTQ_LOCKFREE
+#define CUPKEE_EVENTQ_LOCKFREE          (1)
+#endif
+// Stamp events at post & dispatch, keep last CUPKEE_EVENT_TRACE_SIZE of
+// them and queueing delay of each type, 0 to disable
+#ifndef CUPKEE_EVENT_TRACE
+#define CUPKEE_EVENT_TRACE              (0)
+#endif
+#define CUPKEE_EVENT_TRACE_SIZE         (32)
+#define CUPKEE_EVENT_TRACE_HIST         (12)
+
+// Sleep in main loop till the next deadline, when nothing to do
+#ifndef CUPKEE_IDLE
+#define CUPKEE_IDLE                     (1)
+#endif
+
+// Timeout wheel, levels of 2^BITS slots cover 2^(BITS * LEVELS) ticks,
+// longer wait is re-placed when it comes to the last level
+#ifndef CUPKEE_TIMEOUT_WHEEL_BITS
+#define CUPKEE_TIMEOUT_WHEEL_BITS       (5)
+#endif
+#ifndef CUPKEE_TIMEOUT_WHEEL_LEVELS
+#define CUPKEE_TIMEOUT_WHEEL_LEVELS     (4)
+#endif
+// Buckets of timeout id index, power of 2. Ids are sequential, so chains
+// are about timeouts / buckets long: index is doubled from heap, up to
+// CUPKEE_TIMEOUT_ID_HASH_MAX, to keep load factor under ID_LOAD
+#ifndef CUPKEE_TIMEOUT_ID_HASH
+#define CUPKEE_TIMEOUT_ID_HASH          (8)
+#endif
+#ifndef CUPKEE_TIMEOUT_ID_HASH_MAX
+#define CUPKEE_TIMEOUT_ID_HASH_MAX      (1024)
+#endif
+#define CUPKEE_TIMEOUT_ID_LOAD          (2)
+
+// Process steps run in each iteration of main loop at most
+#ifndef CUPKEE_PROCESS_BUDGET
+#define CUPKEE_PROCESS_BUDGET           (4)
+#endif
 
 // Pin
 #define CUPKEE_PIN_MAX                  32
 
+// Object
+#define CUPKEE_OBJECT_TAG_MAX           (16)
+// Objects preallocated in pool of the tag at setup, created & destroyed
+// without heap till pool is used up, 0 to take all from heap
+#ifndef CUPKEE_TIMER_RESERVE
+#define CUPKEE_TIMER_RESERVE            (4)
+#endif
+#ifndef CUPKEE_PIN_GROUP_RESERVE
+#define CUPKEE_PIN_GROUP_RESERVE        (2)
+#endif
+#ifndef CUPKEE_DEVICE_RESERVE
+#define CUPKEE_DEVICE_RESERVE           (2)
+#endif
+
+// Main loop meter, stats over CUPKEE_METER_SLOTS * CUPKEE_METER_SLOT_MS
+#ifndef CUPKEE_METER
+#define CUPKEE_METER                    (1)
+#endif
+#define CUPKEE_METER_SLOTS              (4)
+#define CUPKEE_METER_SLOT_MS            (250)
+
 // Memory
 #define CUPKEE_ZONE_MAX                 2
 
@@ -34,8 +131,17 @@
 #define CUPKEE_PAGE_MASK                (((intptr_t)(-1)) << CUPKEE_PAGE_SHIFT)
 #define CUPKEE_PAGE_ORDERR_MAX          (8)
 
-#define CUPKEE_MUNIT_SHIFT              (5)
+#define CUPKEE_MUNIT_SHIFT              (3)
 #define CUPKEE_MUNIT_SIZE               (1U << CUPKEE_MUNIT_SHIFT)
 
+#define CUPKEE_MBCQ_MAX                 (11)
+#define CUPKEE_MBCQ_CACHE_DEF           (1)
+
+// Record malloc & free into a ring of CUPKEE_MEMORY_TRACE_SIZE, 0 to disable
+#ifndef CUPKEE_MEMORY_TRACE
+#define CUPKEE_MEMORY_TRACE             (0)
+#endif
+#define CUPKEE_MEMORY_TRACE_SIZE        (128)
+
 #endif /* __CUPKEE_CONFIG_INC__ */
 
@@ -46,6 +46,7 @@
 #define CUPKEE_SYSDISK_SECTOR_COUNT		1024 * 32
 
 #define CUPKEE_FLAG_REPEAT              0x01
+#define CUPKEE_FLAG_CATCHUP             0x02    // repeat timeout run each missed period
 #define CUPKEE_FLAG_KEEP                0x40
 #define CUPKEE_FLAG_LANG                0x80
 
@@ -48,6 +48,9 @@ typedef struct cupkee_device_desc_t {
     uint8_t  inst_max;
     cupkee_struct_t *(*conf_init)(void *curr);
     const cupkee_driver_t *driver;
+    // Stream buffer size, 0: CUPKEE_DEVICE_STREAM_SIZE
+    uint16_t rx_size;
+    uint16_t tx_size;
 } cupkee_device_desc_t;
 
 struct cupkee_device_t {
@@ -74,6 +77,8 @@ int cupkee_device_setup(void);
 int cupkee_device_tag(void);
 void cupkee_device_sync(uint32_t systicks);
 void cupkee_device_poll(void);
+/* Ticks to the next sync has work to do, 0 if any device should be polled */
+uint32_t cupkee_device_next(uint32_t systicks);
 int  cupkee_device_register(const cupkee_device_desc_t *desc);
 
 void *cupkee_device_request(const char *name, int instance);
@@ -88,6 +93,8 @@ cupkee_struct_t *cupkee_device_config(void *entry);
 int cupkee_device_enable(void *entry);
 int cupkee_device_disable(void *entry);
 int cupkee_device_is_enabled(void *entry);
+/* Query in flight, response not dispatched yet */
+int cupkee_device_is_busy(void *entry);
 
 int cupkee_device_query(void *entry, size_t req_len, void *req_data, int want, cupkee_callback_t cb, intptr_t param);
 int cupkee_device_query_nocopy(void *entry, size_t req_len, void *req_data, int want, cupkee_callback_t cb, intptr_t param);
@@ -105,6 +112,17 @@ int cupkee_device_response_take(void *entry, void **pbuf);
 
 int cupkee_device_push(void *entry, size_t n, const void *data);
 int cupkee_device_pull(void *entry, size_t n, void *buf);
+int cupkee_device_push_buf(void *entry, void *b);
+void *cupkee_device_pull_buf(void *entry);
+void cupkee_device_free_buf(void *entry, void *b);
+
+void *cupkee_device_read_buf(void *entry);
+int cupkee_device_write_buf(void *entry, void *b);
+
+/* Grow stream buffer of enabled device, 0: keep size. All or nothing,
+ * -CUPKEE_EBUSY if any buffer to grow has data cached.
+ */
+int cupkee_device_stream_resize(void *entry, size_t rx_size, size_t tx_size);
 
 static inline void cupkee_device_set_error(void *entry, uint8_t code) {
     cupkee_object_error_set(CUPKEE_OBJECT_PTR(entry), code);
@@ -23,7 +23,26 @@
 enum CUPKEE_EVENT_TYPE {
     EVENT_SYSTICK = 0,
     EVENT_OBJECT  = 1,
-    EVENT_PIN     = 2
+    EVENT_PIN     = 2,
+
+    EVENT_TYPE_MAX
+};
+
+/* Event queue flags
+ * COALESCE_SYSTICK: only one systick event is pending in queue
+ * COALESCE_SAME:    event same as a pending one is not queued again
+ */
+#define CUPKEE_EVENTQ_COALESCE_SYSTICK  (0x01)
+#define CUPKEE_EVENTQ_COALESCE_SAME     (0x02)
+
+/* Events of high priority are taken before low ones, a low event is let
+ * go first after CUPKEE_EVENTQ_HIGH_BURST high events taken in a row.
+ */
+enum CUPKEE_EVENT_PRIO {
+    CUPKEE_EVENT_PRIO_LOW = 0,
+    CUPKEE_EVENT_PRIO_HIGH,
+
+    CUPKEE_EVENT_PRIO_MAX
 };
 
 enum CUPKEE_EVENT_OBJECT {
@@ -61,13 +80,61 @@ typedef struct cupkee_event_t {
     uint16_t which;
 } cupkee_event_t;
 
+typedef struct cupkee_event_stat_t {
+    uint16_t depth;
+    uint16_t peak;                      // max events pending
+    uint16_t high_depth;
+    uint16_t high_peak;
+    uint32_t coalesced;
+    uint32_t dropped[EVENT_TYPE_MAX];   // dropped for queue full, by type
+} cupkee_event_stat_t;
+
+typedef struct cupkee_event_trace_t {
+    uint32_t post;          // hw_cycle_count() when posted
+    uint32_t dispatch;      // hw_cycle_count() when dispatched
+    uint8_t  type;
+    uint8_t  code;
+    uint16_t which;
+} cupkee_event_trace_t;
+
+typedef struct cupkee_event_delay_t {
+    uint32_t count;
+    uint32_t min;           // us
+    uint32_t avg;
+    uint32_t max;
+    uint32_t hist[CUPKEE_EVENT_TRACE_HIST]; // delay < (1 << i) us, the last one for longer
+} cupkee_event_delay_t;
+
 typedef int  (*cupkee_event_handle_t)(cupkee_event_t *);
 
-void cupkee_event_setup(void);
+/* Queue memory is taken from heap, queues of last setup are released.
+ * high_depth 0: no high priority queue, all events go to the low one.
+ */
+int  cupkee_event_setup(int depth, int high_depth, int flags);
+/* Release queue memory, before heap is gone */
+void cupkee_event_deinit(void);
 void cupkee_event_reset(void);
+void cupkee_event_stats(cupkee_event_stat_t *stat);
+
+/* Priority of event type used by cupkee_event_post, pin is high default */
+int cupkee_event_prio_set(uint8_t type, int prio);
 
 int cupkee_event_post(uint8_t type, uint8_t code, uint16_t which);
+int cupkee_event_post_prio(int prio, uint8_t type, uint8_t code, uint16_t which);
 int cupkee_event_take(cupkee_event_t *event);
+int cupkee_event_pending(void);
+/* Take up to max events in order, return number taken */
+int cupkee_event_take_batch(cupkee_event_t *events, int max);
+
+/* Event trace, work only if CUPKEE_EVENT_TRACE is enabled.
+ * cupkee_event_trace_dispatch: call before dispatch events[i] of last batch taken
+ * cupkee_event_trace_read:     take out the oldest records, return count taken
+ * cupkee_event_delay_get:      queueing delay of event type, -CUPKEE_EIMPLEMENT if disabled
+ */
+void     cupkee_event_trace_dispatch(int i, const cupkee_event_t *e);
+int      cupkee_event_trace_read(cupkee_event_trace_t *rec, int max);
+uint32_t cupkee_event_trace_lost(void);
+int      cupkee_event_delay_get(uint8_t type, cupkee_event_delay_t *delay);
 
 static inline int cupkee_event_post_systick(void) {
     return cupkee_event_post(EVENT_SYSTICK, 0, 0);
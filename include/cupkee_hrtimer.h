@@ -0,0 +1,61 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#ifndef __CUPKEE_HRTIMER_INC__
+#define __CUPKEE_HRTIMER_INC__
+
+/* High resolution timers in microseconds, all multiplexed on one hardware
+ * timer, which is programmed for the nearest deadline.
+ *
+ * Handler is called in timer interrupt, keep it short, post event to do
+ * others in main loop.
+ */
+struct cupkee_hrtimer_t;
+typedef void (*cupkee_hrtimer_handle_t)(struct cupkee_hrtimer_t *t, void *param);
+
+typedef struct cupkee_hrtimer_t {
+    struct cupkee_hrtimer_t *next;
+    cupkee_hrtimer_handle_t handle;
+    void    *param;
+    uint32_t expire;    // us, of hw_hrtimer_now
+    uint32_t period;    // us, 0: one shot
+    uint8_t  active;
+} cupkee_hrtimer_t;
+
+void cupkee_hrtimer_setup(void);
+
+void cupkee_hrtimer_init(cupkee_hrtimer_t *t, cupkee_hrtimer_handle_t handle, void *param);
+
+/* Fire after us, and every period us if period is not 0 */
+int cupkee_hrtimer_start(cupkee_hrtimer_t *t, uint32_t us, uint32_t period);
+int cupkee_hrtimer_stop(cupkee_hrtimer_t *t);
+
+static inline int cupkee_hrtimer_is_active(cupkee_hrtimer_t *t) {
+    return t->active;
+}
+
+static inline uint32_t cupkee_hrtimer_now(void) {
+    return hw_hrtimer_now();
+}
+
+// Should only be call in BSP, when alarm is reached
+void cupkee_hrtimer_expire(void);
+
+#endif /* __CUPKEE_HRTIMER_INC__ */
+
@@ -25,16 +25,70 @@ typedef struct cupkee_page_t {
 
     uint8_t flags;
     uint8_t used;
-    uint16_t order;
+    uint8_t order;
+    uint8_t mbcq;
 
     intptr_t blocks;
 } cupkee_page_t;
 
+typedef struct cupkee_memory_stat_t {
+    uint32_t free_pages[CUPKEE_PAGE_ORDERR_MAX];    // free pages of each order
+    uint32_t mbcq_size[CUPKEE_MBCQ_MAX];            // block size of each queue
+    uint32_t mbcq_pages[CUPKEE_MBCQ_MAX];           // pages hold by each queue
+    uint32_t mbcq_blocks[CUPKEE_MBCQ_MAX];          // used blocks of each queue
+    uint32_t bytes_used;                            // blocks & pages, arena included
+    uint32_t bytes_peak;
+    uint32_t alloc_fails;
+    uint32_t free_bytes;
+    uint32_t largest_free;
+    uint32_t cache_kept;
+    uint32_t cache_reused;
+    uint8_t  fragment;                              // 0 ~ 100
+} cupkee_memory_stat_t;
+
+enum cupkee_memory_trace_op_e {
+    CUPKEE_TRACE_ALLOC = 0,
+    CUPKEE_TRACE_FREE,
+    CUPKEE_TRACE_REALLOC,
+};
+
+#define CUPKEE_TRACE_ORDER_BLOCK    (0xFF)
+
+typedef struct cupkee_memory_trace_t {
+    uint32_t  tick;
+    uint32_t  size;     // requested size, 0 for free
+    uintptr_t ptr;      // result of alloc, or memory freed
+    uintptr_t prev;     // memory resized by realloc
+    uint8_t   op;
+    uint8_t   order;    // page order of ptr, CUPKEE_TRACE_ORDER_BLOCK for block
+} cupkee_memory_trace_t;
+
 int cupkee_memory_setup(void);
+
+/* Add memory region as a new zone, return zone id */
 int cupkee_memory_extend(intptr_t base, size_t size);
+/* Zone with higher prefer is used first, 0 at default */
+int cupkee_memory_prefer(int zone_id, int prefer);
 
 int cupkee_free_pages(int order);
 
+/* Empty page cache of block queues
+ * size: the queue serve this size, 0 for all queues
+ * pages: max empty pages to keep in queue
+ */
+int  cupkee_memory_cache_set(size_t size, int pages);
+void cupkee_memory_cache_stat(uint32_t *kept, uint32_t *reused);
+int  cupkee_memory_reclaim(void);
+
+int cupkee_memory_stats(cupkee_memory_stat_t *stat);
+
+/* Take out the oldest records of trace, return count of record taken.
+ * Always 0, if CUPKEE_MEMORY_TRACE is disabled.
+ */
+int      cupkee_memory_trace_read(cupkee_memory_trace_t *rec, int max);
+/* Records overwritten before read */
+uint32_t cupkee_memory_trace_lost(void);
+
 void *cupkee_page_memory(cupkee_page_t *page);
 cupkee_page_t *cupkee_memory_page(void *ptr);
 
@@ -43,6 +97,8 @@ void cupkee_page_free(cupkee_page_t *page);
 
 void *cupkee_malloc(size_t s);
 void  cupkee_free(void *p);
+/* Resize in place when possible, original memory is kept on failure */
+void *cupkee_realloc(void *p, size_t s);
 
 #endif /* __CUPKEE_MEMORY_INC__ */
 
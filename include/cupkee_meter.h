@@ -0,0 +1,82 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#ifndef __CUPKEE_METER_INC__
+#define __CUPKEE_METER_INC__
+
+/* Main loop meter, time of each part is counted in slot of
+ * CUPKEE_METER_SLOT_MS, stats are summed over the last CUPKEE_METER_SLOTS
+ * slots finished.
+ */
+enum CUPKEE_METER_ITEM {
+    CUPKEE_METER_DEVICE = 0,    // device polling
+    CUPKEE_METER_EVENT,         // event taking & dispatch, handlers included
+    CUPKEE_METER_SYSTICK,       // systick handler: device & timeout sync
+    CUPKEE_METER_PIN,           // pin event handler
+    CUPKEE_METER_PROCESS,       // process steps
+    CUPKEE_METER_OBJECT,        // object event handler, one for each tag
+
+    CUPKEE_METER_ITEM_MAX = CUPKEE_METER_OBJECT + CUPKEE_OBJECT_TAG_MAX
+};
+
+typedef struct cupkee_meter_stat_t {
+    uint32_t window;        // ms
+    uint32_t loops;         // iterations in window
+    uint32_t loops_per_sec;
+    uint32_t idle;          // iterations did no work
+    uint32_t loop_max;      // us, the longest iteration
+    uint32_t time[CUPKEE_METER_ITEM_MAX];   // us spent in window
+} cupkee_meter_stat_t;
+
+#if CUPKEE_METER
+
+void cupkee_meter_setup(void);
+
+/* Account cycles from begin to end to the item */
+void cupkee_meter_add(int item, uint32_t begin, uint32_t end);
+
+/* Iteration of main loop finished, worked: any event dispatched */
+void cupkee_meter_loop(uint32_t begin, uint32_t end, int worked);
+
+int  cupkee_meter_stats(cupkee_meter_stat_t *stat);
+
+static inline uint32_t cupkee_meter_stamp(void) {
+    return hw_cycle_count();
+}
+
+#else
+
+static inline void cupkee_meter_setup(void) {}
+static inline void cupkee_meter_add(int item, uint32_t begin, uint32_t end) {
+    (void) item; (void) begin; (void) end;
+}
+static inline void cupkee_meter_loop(uint32_t begin, uint32_t end, int worked) {
+    (void) begin; (void) end; (void) worked;
+}
+static inline int cupkee_meter_stats(cupkee_meter_stat_t *stat) {
+    (void) stat;
+    return -CUPKEE_EIMPLEMENT;
+}
+static inline uint32_t cupkee_meter_stamp(void) {
+    return 0;
+}
+
+#endif
+
+#endif /* __CUPKEE_METER_INC__ */
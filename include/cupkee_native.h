@@ -23,6 +23,10 @@
 /* cupkee_shell_misc.c */
 val_t native_sysinfos(env_t *env, int ac, val_t *av);
 val_t native_systicks(env_t *env, int ac, val_t *av);
+val_t native_meminfo(env_t *env, int ac, val_t *av);
+val_t native_memtrace(env_t *env, int ac, val_t *av);
+val_t native_eventinfo(env_t *env, int ac, val_t *av);
+val_t native_loopinfo(env_t *env, int ac, val_t *av);
 val_t native_print(env_t *env, int ac, val_t *av);
 val_t native_erase(env_t *env, int ac, val_t *av);
 val_t native_reset(env_t *env, int ac, val_t *av);
@@ -66,7 +66,8 @@ typedef struct cupkee_object_t {
 } cupkee_object_t;
 
 int  cupkee_object_setup(void);
-void cupkee_object_event_dispatch(uint16_t which, uint8_t code);
+/* Return tag of object handled, -1 if none */
+int  cupkee_object_event_dispatch(uint16_t which, uint8_t code);
 void cupkee_object_gc(void);
 
 static inline int cupkee_is_object(void *entry, uint8_t tag) {
@@ -77,7 +78,8 @@ static inline void cupkee_object_event_post(int id, uint8_t code) {
     cupkee_event_post(EVENT_OBJECT, code, id);
 }
 
-int  cupkee_object_register(size_t size, const cupkee_desc_t *desc);
+/* reserve: number of objects preallocated for the tag, 0 for none */
+int  cupkee_object_register(size_t size, const cupkee_desc_t *desc, int reserve);
 void cupkee_object_set_meta(int tag, void *meta);
 
 
@@ -0,0 +1,58 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#ifndef __CUPKEE_POOL_INC__
+#define __CUPKEE_POOL_INC__
+
+/* Fixed size block pool, safe to alloc & free from interrupt and main loop
+ * at the same time: free blocks are linked by index, the list head is
+ * updated with compare-and-swap (LDREX/STREX on cortex-m), and carries a
+ * tag against ABA.
+ */
+typedef struct cupkee_pool_t {
+    uint8_t  *base;
+    uint16_t block_size;
+    uint16_t block_num;
+    uint32_t head;          // tag << 16 | (index + 1), 0 index for empty
+    uint32_t free_num;
+} cupkee_pool_t;
+
+#define CUPKEE_POOL_BLOCK_MAX   (0xFFFE)
+
+/* Build pool on given memory, which should be aligned to intptr_t and hold
+ * block_num blocks of CUPKEE_SIZE_ALIGN(block_size, sizeof(intptr_t)) bytes.
+ */
+int cupkee_pool_init(cupkee_pool_t *pool, void *mem, size_t block_size, int block_num);
+
+/* Pool and its blocks in heap, should be called from main loop only */
+cupkee_pool_t *cupkee_pool_create(size_t block_size, int block_num);
+void cupkee_pool_release(cupkee_pool_t *pool);
+
+void *cupkee_pool_alloc(cupkee_pool_t *pool);
+void  cupkee_pool_free(cupkee_pool_t *pool, void *block);
+
+static inline int cupkee_pool_free_num(cupkee_pool_t *pool) {
+    return __atomic_load_n(&pool->free_num, __ATOMIC_RELAXED);
+}
+
+static inline size_t cupkee_pool_block_size(cupkee_pool_t *pool) {
+    return pool->block_size;
+}
+
+#endif /* __CUPKEE_POOL_INC__ */
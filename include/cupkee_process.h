@@ -20,6 +20,14 @@
 #ifndef __CUPKEE_PROCESS_INC__
 #define __CUPKEE_PROCESS_INC__
 
+/* Step requested by next & goto is run later, by cupkee_process_poll in
+ * main loop. Should be called in main loop only, not in interrupt.
+ */
+void cupkee_process_setup(void);
+/* Run at most budget steps waiting, return number of steps run */
+int  cupkee_process_poll(int budget);
+int  cupkee_process_pending(void);
+
 int cupkee_process_start(void (*fn)(void *entry), intptr_t data, void (*finish)(int err, intptr_t data));
 
 intptr_t cupkee_process_data(void *entry);
@@ -31,5 +39,20 @@ void cupkee_process_next(void *entry);
 void cupkee_process_done(void *entry);
 void cupkee_process_fail(void *entry, int err);
 
+/* Park process till the condition, then take its next step. Call in step
+ * instead of next, conditions set in the same step are or-ed, and
+ * cupkee_process_woken tell the event code woke it up, or -CUPKEE_ETIMEOUT.
+ */
+int cupkee_process_wait_timeout(void *entry, uint32_t ticks);
+int cupkee_process_wait_object(void *entry, int id, int event);
+int cupkee_process_wait_response(void *entry, void *device);
+int cupkee_process_woken(void *entry);
+
+/* Used by main loop */
+void cupkee_process_sync(uint32_t systicks);
+void cupkee_process_event(uint16_t id, uint8_t code);
+/* Ticks to the nearest timeout of parked processes */
+uint32_t cupkee_process_deadline(uint32_t systicks);
+
 #endif /* __CUPKEE_PROCESS_INC__ */
 
@@ -51,6 +51,11 @@ struct cupkee_stream_t {
     cupkee_buffer_t rx_buf;
     cupkee_buffer_t tx_buf;
 
+    // Blocks handed over without copy, behind bytes in rx_buf & tx_buf
+    cupkee_block_queue_t rx_blocks;
+    cupkee_block_queue_t tx_blocks;
+    cupkee_block_queue_t tx_done;
+
     int (*_read) (cupkee_stream_t *s, size_t n, void *);
     int (*_write)(cupkee_stream_t *s, size_t n, const void *);
 };
@@ -67,6 +72,10 @@ int cupkee_stream_init(
    int (*_write)(cupkee_stream_t *s, size_t n, const void *)
 );
 int cupkee_stream_deinit(cupkee_stream_t *s);
+/* Grow buffer, while nothing cached in it. Both are grown or neither:
+ * -CUPKEE_EBUSY if any buffer to grow is not empty, 0 size to keep.
+ */
+int cupkee_stream_resize(cupkee_stream_t *s, size_t rx_buf_size, size_t tx_buf_size);
 
 void cupkee_stream_listen(cupkee_stream_t *s, int event);
 void cupkee_stream_ignore(cupkee_stream_t *s, int event);
@@ -76,6 +85,8 @@ void cupkee_stream_pause(cupkee_stream_t *s);
 void cupkee_stream_shutdown(cupkee_stream_t *s, uint8_t flags);
 
 void cupkee_stream_sync(cupkee_stream_t *s, uint32_t systicks);
+/* Ticks from systicks to the next sync that has work to do */
+uint32_t cupkee_stream_next(cupkee_stream_t *s, uint32_t systicks);
 int cupkee_stream_push(cupkee_stream_t *s, size_t n, const void *data);
 int cupkee_stream_pull(cupkee_stream_t *s, size_t n, void *data);
 
@@ -89,9 +100,16 @@ int cupkee_stream_unshift(cupkee_stream_t *s, uint8_t data);
 
 void cupkee_stream_set_error(cupkee_stream_t *s, uint8_t err);
 
-
+/* Zero copy: data is block of cupkee_block_alloc, its ownership is passed
+ * with it. push_buf & pull_buf are for driver, read_buf & write_buf for user.
+ * Bytes cached by the copy API come first, so the two can be mixed.
+ *
+ * Driver may run in interrupt: it pushes block of cupkee_block_alloc_pooled,
+ * and hands block of pull_buf back with free_buf, once it is sent.
+ */
 int cupkee_stream_push_buf(cupkee_stream_t *s, void *data);
 void *cupkee_stream_pull_buf(cupkee_stream_t *s);
+void cupkee_stream_free_buf(cupkee_stream_t *s, void *data);
 
 void *cupkee_stream_read_buf(cupkee_stream_t *s);
 int cupkee_stream_write_buf(cupkee_stream_t *s, void *data);
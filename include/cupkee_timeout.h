@@ -24,21 +24,38 @@ extern volatile uint32_t _cupkee_systicks;
 
 typedef void (*cupkee_timeout_handle_t)(int drop, void *param);
 typedef struct cupkee_timeout_t {
-    struct cupkee_timeout_t *next;
+    struct cupkee_timeout_t *next;      // in wheel slot
+    struct cupkee_timeout_t **pprev;
+    struct cupkee_timeout_t *id_next;   // in id index
+    struct cupkee_timeout_t **id_pprev;
     cupkee_timeout_handle_t handle;
     int      id;
     int      flags;
+    int      drop;                      // marked by clear
     uint32_t wait;
-    uint32_t from;
+    uint32_t expire;
     void    *param;
 } cupkee_timeout_t;
 
+#define CUPKEE_TICKS_FOREVER    (0xFFFFFFFF)
+
 void cupkee_timeout_setup(void);
 void cupkee_timeout_sync(uint32_t ticks);
+/* Ticks from now to the nearest deadline, CUPKEE_TICKS_FOREVER if none */
+uint32_t cupkee_timeout_next(uint32_t ticks);
 
 cupkee_timeout_t *cupkee_timeout_register(uint32_t wait, int repeat, cupkee_timeout_handle_t handle, void *param);
+/* Nothing done, if t is not registered (released after expired),
+ * unless its memory is taken by a new timeout already
+ */
 void cupkee_timeout_unregister(cupkee_timeout_t *t);
 
+/* Periods missed before this call, valid in handler of repeat timeout.
+ * Repeat timeout keep to deadline of from + n * wait, missed periods are
+ * skipped, or run back to back with CUPKEE_FLAG_CATCHUP.
+ */
+uint32_t cupkee_timeout_missed(void);
+
 int cupkee_timeout_clear_all(void);
 int cupkee_timeout_clear_with_flags(uint32_t flags);
 int cupkee_timeout_clear_with_id(uint32_t id);
@@ -59,7 +59,7 @@ static inline intptr_t cupkee_timer_callback_param(void *entry) {
 // Should only be call in BSP
 static inline void cupkee_timer_rewind(int id)
 {
-    cupkee_object_event_post(id, CUPKEE_EVENT_REWIND);
+    cupkee_event_post_prio(CUPKEE_EVENT_PRIO_HIGH, EVENT_OBJECT, CUPKEE_EVENT_REWIND, id);
 }
 
 #endif /* __CUPKEE_TIMER_INC__ */
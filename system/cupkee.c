@@ -23,21 +23,66 @@
 
 static const uint8_t *cupkee_board_id = NULL;
 
-void cupkee_event_poll(void)
+static inline void event_dispatch(cupkee_event_t *e)
 {
-    cupkee_event_t e;
-
-    while (cupkee_event_take(&e)) {
-        if (e.type == EVENT_SYSTICK) {
-            cupkee_device_sync(_cupkee_systicks);
-            cupkee_timeout_sync(_cupkee_systicks);
-        } else
-        if (e.type == EVENT_OBJECT) {
-            cupkee_object_event_dispatch(e.which, e.code);
-        } else
-        if (e.type == EVENT_PIN) {
-            cupkee_pin_event_dispatch(e.which, e.code);
+    uint32_t begin = cupkee_meter_stamp();
+    int item;
+
+    if (e->type == EVENT_SYSTICK) {
+        cupkee_device_sync(_cupkee_systicks);
+        cupkee_timeout_sync(_cupkee_systicks);
+        cupkee_process_sync(_cupkee_systicks);
+        item = CUPKEE_METER_SYSTICK;
+    } else
+    if (e->type == EVENT_OBJECT) {
+        int tag = cupkee_object_event_dispatch(e->which, e->code);
+        cupkee_process_event(e->which, e->code);
+        item = tag < 0 ? -1 : CUPKEE_METER_OBJECT + tag;
+    } else
+    if (e->type == EVENT_PIN) {
+        cupkee_pin_event_dispatch(e->which, e->code);
+        item = CUPKEE_METER_PIN;
+    } else {
+        item = -1;
+    }
+
+    cupkee_meter_add(item, begin, cupkee_meter_stamp());
+}
+
+int cupkee_event_poll(void)
+{
+    cupkee_event_t batch[CUPKEE_EVENT_BATCH];
+    int i, n, total = 0;
+
+    while ((n = cupkee_event_take_batch(batch, CUPKEE_EVENT_BATCH)) > 0) {
+        for (i = 0; i < n; i++) {
+#if CUPKEE_EVENT_TRACE
+            cupkee_event_trace_dispatch(i, &batch[i]);
+#endif
+            event_dispatch(&batch[i]);
         }
+        total += n;
+    }
+
+    return total;
+}
+
+void cupkee_idle(void)
+{
+    uint32_t now = _cupkee_systicks;
+    uint32_t wait = cupkee_timeout_next(now);
+    uint32_t next = cupkee_device_next(now);
+
+    if (next < wait) {
+        wait = next;
+    }
+    next = cupkee_process_deadline(now);
+    if (next < wait) {
+        wait = next;
+    }
+
+    if (wait && !cupkee_event_pending() && !cupkee_process_pending()) {
+        hw_idle(now + (wait < CUPKEE_TICKS_FOREVER ? wait : 0x7FFFFFFF));
     }
 }
 
@@ -76,13 +121,22 @@ void cupkee_init(const uint8_t *id)
     /* System setup */
     cupkee_memory_setup();
 
+    cupkee_block_setup();
+
     cupkee_object_setup();
 
     cupkee_timeout_setup();
 
+    cupkee_process_setup();
+
     cupkee_timer_setup();
 
-    cupkee_event_setup();
+    cupkee_hrtimer_setup();
+
+    if (0 != cupkee_event_setup(CUPKEE_EVENTQ_SIZE, CUPKEE_EVENTQ_HIGH_SIZE, CUPKEE_EVENTQ_FLAGS)) {
+        // Nothing works without event queue
+        hw_halt();
+    }
 
     cupkee_pin_setup();
 
@@ -103,10 +157,36 @@ void cupkee_loop(void)
     // Reset systick at first
     _cupkee_systicks = 0;
 
+    cupkee_meter_setup();
+
     while (1) {
+        uint32_t begin = cupkee_meter_stamp();
+        uint32_t polled, end;
+        int worked;
+
         cupkee_device_poll();
+        polled = cupkee_meter_stamp();
+        cupkee_meter_add(CUPKEE_METER_DEVICE, begin, polled);
+
+        worked = cupkee_event_poll();
+        end = cupkee_meter_stamp();
+        cupkee_meter_add(CUPKEE_METER_EVENT, polled, end);
+
+        // Steps of process requested, interleaved with events
+        if (cupkee_process_pending()) {
+            worked += cupkee_process_poll(CUPKEE_PROCESS_BUDGET);
+            polled = end;
+            end = cupkee_meter_stamp();
+            cupkee_meter_add(CUPKEE_METER_PROCESS, polled, end);
+        }
+
+        cupkee_meter_loop(begin, end, worked);
 
-        cupkee_event_poll();
+#if CUPKEE_IDLE
+        if (!worked) {
+            cupkee_idle();
+        }
+#endif
     }
 }
 
@@ -0,0 +1,117 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include "cupkee.h"
+
+static inline cupkee_page_t *arena_page(cupkee_arena_t *arena)
+{
+    return list_is_empty(&arena->pages) ? NULL : (cupkee_page_t *)arena->pages.next;
+}
+
+static inline uint8_t *arena_page_end(cupkee_page_t *page)
+{
+    return (uint8_t *)cupkee_page_memory(page) + (CUPKEE_PAGE_SIZE << page->order);
+}
+
+static void arena_drop_to(cupkee_arena_t *arena, cupkee_page_t *keep)
+{
+    cupkee_page_t *page;
+
+    while (NULL != (page = arena_page(arena)) && page != keep) {
+        list_del(&page->list);
+        cupkee_page_free(page);
+    }
+}
+
+void cupkee_arena_init(cupkee_arena_t *arena)
+{
+    list_head_init(&arena->pages);
+    arena->pos = NULL;
+    arena->end = NULL;
+}
+
+void *cupkee_arena_alloc(cupkee_arena_t *arena, size_t size)
+{
+    cupkee_page_t *page;
+    void *p;
+    int order = 0;
+
+    size = CUPKEE_SIZE_ALIGN(size, sizeof(intptr_t));
+    if (!size) {
+        return NULL;
+    }
+
+    if (!arena->pos || arena->pos + size > arena->end) {
+        while (size > (CUPKEE_PAGE_SIZE << order)) {
+            if (++order >= CUPKEE_PAGE_ORDERR_MAX) {
+                return NULL;
+            }
+        }
+
+        if (NULL == (page = cupkee_page_alloc(order))) {
+            return NULL;
+        }
+        list_add(&page->list, &arena->pages);
+
+        arena->pos = cupkee_page_memory(page);
+        arena->end = arena_page_end(page);
+    }
+
+    p = arena->pos;
+    arena->pos += size;
+
+    return p;
+}
+
+void cupkee_arena_reset(cupkee_arena_t *arena)
+{
+    cupkee_page_t *first;
+
+    if (list_is_empty(&arena->pages)) {
+        return;
+    }
+
+    first = (cupkee_page_t *)arena->pages.prev;
+    arena_drop_to(arena, first);
+
+    arena->pos = cupkee_page_memory(first);
+    arena->end = arena_page_end(first);
+}
+
+void cupkee_arena_release(cupkee_arena_t *arena)
+{
+    arena_drop_to(arena, NULL);
+
+    arena->pos = NULL;
+    arena->end = NULL;
+}
+
+void cupkee_arena_mark(cupkee_arena_t *arena, cupkee_arena_mark_t *mark)
+{
+    mark->page = arena_page(arena);
+    mark->pos  = arena->pos;
+}
+
+void cupkee_arena_rewind(cupkee_arena_t *arena, const cupkee_arena_mark_t *mark)
+{
+    arena_drop_to(arena, mark->page);
+
+    arena->pos = mark->pos;
+    arena->end = mark->page ? arena_page_end(mark->page) : NULL;
+}
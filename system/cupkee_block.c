@@ -0,0 +1,226 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include "cupkee.h"
+
+static cupkee_pool_t *block_pool = NULL;
+
+static inline void *block_init(cupkee_block_t *b, size_t cap, int flags)
+{
+    b->next = NULL;
+    b->cap = cap;
+    b->bgn = 0;
+    b->len = 0;
+    b->flags = flags;
+
+    return b;
+}
+
+int cupkee_block_setup(void)
+{
+    // Called after memory setup, the pool of previous heap is gone with it
+    block_pool = cupkee_pool_create(sizeof(cupkee_block_t) + CUPKEE_BLOCK_POOL_SIZE, CUPKEE_BLOCK_POOL_NUM);
+
+    return block_pool ? CUPKEE_OK : -CUPKEE_ENOMEM;
+}
+
+void *cupkee_block_alloc_pooled(void)
+{
+    cupkee_block_t *b = block_pool ? cupkee_pool_alloc(block_pool) : NULL;
+
+    return b ? block_init(b, CUPKEE_BLOCK_POOL_SIZE, CUPKEE_BLOCK_FL_POOL) : NULL;
+}
+
+void *cupkee_block_alloc(size_t size)
+{
+    cupkee_block_t *b;
+
+    if (!size || size > 0xFFFF) {
+        return NULL;
+    }
+
+    if (size <= CUPKEE_BLOCK_POOL_SIZE && NULL != (b = cupkee_block_alloc_pooled())) {
+        return b;
+    }
+
+    b = cupkee_malloc(sizeof(cupkee_block_t) + size);
+    return b ? block_init(b, size, 0) : NULL;
+}
+
+void *cupkee_block_create(size_t n, const void *data)
+{
+    cupkee_block_t *b = cupkee_block_alloc(n);
+
+    if (b) {
+        memcpy(b->data, data, n);
+        b->len = n;
+    }
+    return b;
+}
+
+void cupkee_block_release(void *b)
+{
+    if (!b) {
+        return;
+    }
+
+    if (cupkee_block_is_pooled(b)) {
+        cupkee_pool_free(block_pool, b);
+    } else {
+        cupkee_free(b);
+    }
+}
+
+void cupkee_block_queue_push(cupkee_block_queue_t *q, void *b)
+{
+    cupkee_block_t *blk = b;
+    uint32_t state;
+
+    blk->next = NULL;
+
+    hw_enter_critical(&state);
+    if (q->tail) {
+        q->tail->next = blk;
+    } else {
+        q->head = blk;
+    }
+    q->tail = blk;
+    q->bytes += blk->len;
+    hw_exit_critical(state);
+}
+
+void *cupkee_block_queue_pop(cupkee_block_queue_t *q)
+{
+    cupkee_block_t *blk;
+    uint32_t state;
+
+    hw_enter_critical(&state);
+    blk = q->head;
+    if (blk) {
+        q->head = blk->next;
+        if (!q->head) {
+            q->tail = NULL;
+        }
+        q->bytes -= blk->len;
+        blk->next = NULL;
+    }
+    hw_exit_critical(state);
+
+    return blk;
+}
+
+int cupkee_block_queue_give(cupkee_block_queue_t *q, size_t n, const void *data)
+{
+    const uint8_t *src = data;
+    cupkee_block_t *blk;
+    size_t cnt = 0;
+    uint32_t state;
+
+    // Tail may be drained and released by consumer, fill it in critical section
+    hw_enter_critical(&state);
+    blk = q->tail;
+    if (blk) {
+        cnt = blk->cap - blk->bgn - blk->len;
+        if (cnt > n) {
+            cnt = n;
+        }
+        memcpy(blk->data + blk->bgn + blk->len, src, cnt);
+        blk->len += cnt;
+        q->bytes += cnt;
+    }
+    hw_exit_critical(state);
+
+    while (cnt < n && NULL != (blk = cupkee_block_alloc_pooled())) {
+        size_t part = n - cnt;
+
+        if (part > blk->cap) {
+            part = blk->cap;
+        }
+        memcpy(blk->data, src + cnt, part);
+        blk->len = part;
+        cnt += part;
+
+        cupkee_block_queue_push(q, blk);
+    }
+
+    return cnt;
+}
+
+int cupkee_block_queue_take(cupkee_block_queue_t *q, size_t n, void *buf, cupkee_block_queue_t *done)
+{
+    uint8_t *dst = buf;
+    size_t cnt = 0;
+
+    while (cnt < n) {
+        cupkee_block_t *blk;
+        size_t part;
+        uint32_t state;
+
+        hw_enter_critical(&state);
+        blk = q->head;
+        part = blk ? blk->len : 0;
+        hw_exit_critical(state);
+
+        if (!blk) {
+            break;
+        }
+
+        // Producer only appends behind the data, copy out of critical section
+        if (part > n - cnt) {
+            part = n - cnt;
+        }
+        memcpy(dst + cnt, blk->data + blk->bgn, part);
+        cnt += part;
+
+        // Unlink drained block at once, before producer append to it
+        hw_enter_critical(&state);
+        blk->bgn += part;
+        blk->len -= part;
+        q->bytes -= part;
+        if (blk->len) {
+            blk = NULL;
+        } else {
+            q->head = blk->next;
+            if (!q->head) {
+                q->tail = NULL;
+            }
+            blk->next = NULL;
+        }
+        hw_exit_critical(state);
+
+        if (blk) {
+            if (done && !cupkee_block_is_pooled(blk)) {
+                cupkee_block_queue_push(done, blk);
+            } else {
+                cupkee_block_release(blk);
+            }
+        }
+    }
+
+    return cnt;
+}
+
+void cupkee_block_queue_clear(cupkee_block_queue_t *q)
+{
+    void *b;
+
+    while (NULL != (b = cupkee_block_queue_pop(q))) {
+        cupkee_block_release(b);
+    }
+}
@@ -72,11 +72,15 @@ int cupkee_buffer_xxx(cupkee_buffer_t *b, void **pptr)
 
 int cupkee_buffer_space_to(cupkee_buffer_t *b, size_t n) {
     if (n > b->cap) {
-        void *ptr= cupkee_malloc(n);
+        void *ptr;
+
+        if (b->ptr && (b->flags & CUPKEE_FLAG_OWNED)) {
+            // Grow in place if possible, old data is dropped anyway
+            ptr = cupkee_realloc(b->ptr, n);
+        } else {
+            ptr = cupkee_malloc(n);
+        }
         if (ptr) {
-            if (b->ptr && (b->flags & CUPKEE_FLAG_OWNED)) {
-                cupkee_free(b->ptr);
-            }
             b->flags |= CUPKEE_FLAG_OWNED;
             b->ptr = ptr;
             b->cap = n;
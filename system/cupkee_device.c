@@ -182,20 +182,36 @@ static int device_write(cupkee_stream_t *s, size_t n, const void *data)
     }
 }
 
+static size_t device_stream_size(cupkee_device_t *dev, const char *name, size_t def)
+{
+    unsigned size;
+
+    if (!def) {
+        def = CUPKEE_DEVICE_STREAM_SIZE;
+    }
+
+    // Optional item of config, 0 for default
+    if (0 > cupkee_struct_get_uint2(dev->conf, name, &size) || !size) {
+        return def;
+    }
+
+    return size > CUPKEE_DEVICE_STREAM_SIZE_MAX ? CUPKEE_DEVICE_STREAM_SIZE_MAX : size;
+}
+
 static void device_stream_init(cupkee_device_t *dev, int id)
 {
+    const cupkee_device_desc_t *desc = device_descs[dev->type];
     size_t rx_size, tx_size;
     cupkee_stream_t *s;
 
     if (dev->driver->read) {
-        // todo: get from conf
-        rx_size = 32;
+        rx_size = device_stream_size(dev, "rxbuffer", desc->rx_size);
     } else {
         rx_size = 0;
     }
 
     if (dev->driver->write) {
-        tx_size = 32;
+        tx_size = device_stream_size(dev, "txbuffer", desc->tx_size);
     } else {
         tx_size = 0;
     }
@@ -422,7 +438,7 @@ static const cupkee_desc_t device_desc = {
 
 int cupkee_device_setup(void)
 {
-    int tag = cupkee_object_register(sizeof(cupkee_device_t), &device_desc);
+    int tag = cupkee_object_register(sizeof(cupkee_device_t), &device_desc, CUPKEE_DEVICE_RESERVE);
 
     if (tag < 0) {
         return -1;
@@ -472,6 +488,27 @@ void cupkee_device_sync(uint32_t systicks)
     }
 }
 
+uint32_t cupkee_device_next(uint32_t systicks)
+{
+    cupkee_device_t *dev = device_work;
+    uint32_t next = CUPKEE_TICKS_FOREVER;
+
+    while (dev) {
+        if (dev->driver->poll) {
+            return 0;
+        }
+        if (dev->s) {
+            uint32_t t = cupkee_stream_next(dev->s, systicks);
+            if (t < next) {
+                next = t;
+            }
+        }
+        dev = dev->next;
+    }
+
+    return next;
+}
+
 void cupkee_device_poll(void)
 {
     cupkee_device_t *dev = device_work;
@@ -604,6 +641,17 @@ int cupkee_device_is_enabled(void *entry)
     return device_is_enabled(dev);
 }
 
+int cupkee_device_is_busy(void *entry)
+{
+    cupkee_device_t *dev = entry;
+
+    if (!is_device(entry)) {
+        return -CUPKEE_EINVAL;
+    }
+
+    return (dev->flags & DEVICE_FL_BUSY) ? 1 : 0;
+}
+
 int cupkee_device_request_len(void *entry)
 {
     cupkee_device_t *dev = entry;
@@ -784,3 +832,77 @@ int cupkee_device_pull(void *entry, size_t n, void *buf)
     return cupkee_stream_pull(dev->s, n, buf);
 }
 
+int cupkee_device_push_buf(void *entry, void *b)
+{
+    cupkee_device_t *dev = entry;
+
+    if (!is_device(entry)) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (!dev->s) {
+        return -CUPKEE_EIMPLEMENT;
+    }
+
+    return cupkee_stream_push_buf(dev->s, b);
+}
+
+void *cupkee_device_pull_buf(void *entry)
+{
+    cupkee_device_t *dev = entry;
+
+    if (!is_device(entry) || !dev->s) {
+        return NULL;
+    }
+
+    return cupkee_stream_pull_buf(dev->s);
+}
+
+void cupkee_device_free_buf(void *entry, void *b)
+{
+    cupkee_device_t *dev = entry;
+
+    cupkee_stream_free_buf(is_device(entry) ? dev->s : NULL, b);
+}
+
+void *cupkee_device_read_buf(void *entry)
+{
+    cupkee_device_t *dev = entry;
+
+    if (!is_device(entry) || !dev->s) {
+        return NULL;
+    }
+
+    return cupkee_stream_read_buf(dev->s);
+}
+
+int cupkee_device_write_buf(void *entry, void *b)
+{
+    cupkee_device_t *dev = entry;
+
+    if (!is_device(entry)) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (!dev->s) {
+        return -CUPKEE_EIMPLEMENT;
+    }
+
+    return cupkee_stream_write_buf(dev->s, b);
+}
+
+int cupkee_device_stream_resize(void *entry, size_t rx_size, size_t tx_size)
+{
+    cupkee_device_t *dev = entry;
+
+    if (!is_device(entry) || rx_size > CUPKEE_DEVICE_STREAM_SIZE_MAX || tx_size > CUPKEE_DEVICE_STREAM_SIZE_MAX) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (!dev->s) {
+        return -CUPKEE_EIMPLEMENT;
+    }
+
+    return cupkee_stream_resize(dev->s, rx_size, tx_size);
+}
+
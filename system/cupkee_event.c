@@ -18,59 +18,672 @@
  **/
 
 #include "cupkee.h"
-#include "rbuff.h"
 
-#define EVENTQ_SIZE         16
 #define EMITTER_CODE_MAX    65535
 
-static rbuff_t eventq;
-static cupkee_event_t eventq_mem[EVENTQ_SIZE];
+#if CUPKEE_EVENTQ_LOCKFREE
+
+/* Bounded ring with a sequence number in each slot:
+ *   seq == pos:            slot is free for producer of pos
+ *   seq == pos + 1:        slot hold event of pos, ready for consumer
+ *   seq == pos + depth:    consumed, free for producer of next round
+ * Producers (interrupts of any priority and main loop) claim a position by
+ * compare-and-swap on head, consumer is main loop only.
+ */
+typedef struct eventq_slot_t {
+    uint32_t seq;
+    uint32_t data;      // cupkee_event_t, accessed as a whole
+#if CUPKEE_EVENT_TRACE
+    uint32_t stamp;
+#endif
+} eventq_slot_t;
+
+typedef struct eventq_t {
+    eventq_slot_t *mem;
+    uint32_t mask;
+    uint32_t head;
+    uint32_t tail;
+    uint16_t peak;
+} eventq_t;
+
+#define eventq_lock(state)      (void)(state)
+#define eventq_unlock(state)    (void)(state)
 
-void cupkee_event_setup(void)
+static inline void eventq_count(uint32_t *n)
 {
-    rbuff_init(&eventq, EVENTQ_SIZE);
+    __atomic_fetch_add(n, 1, __ATOMIC_RELAXED);
 }
 
-void cupkee_event_reset(void)
+static inline int eventq_flag_set(uint8_t *flag)
 {
-    rbuff_reset(&eventq);
+    return __atomic_exchange_n(flag, 1, __ATOMIC_ACQ_REL);
 }
 
-int cupkee_event_post(uint8_t type, uint8_t code, uint16_t which)
+static inline void eventq_flag_clr(uint8_t *flag)
 {
-    uint32_t state;
-    int pos;
+    __atomic_store_n(flag, 0, __ATOMIC_RELEASE);
+}
 
-    hw_enter_critical(&state);
-    pos = rbuff_push(&eventq);
-    hw_exit_critical(state);
+static inline uint32_t event_pack(uint8_t type, uint8_t code, uint16_t which)
+{
+    cupkee_event_t e = {type, code, which};
+    uint32_t data;
 
-    if (pos < 0) {
+    memcpy(&data, &e, sizeof(data));
+    return data;
+}
+
+static int eventq_init(eventq_t *q, int depth)
+{
+    uint32_t i, n;
+
+    q->mem = NULL;
+    q->mask = 0;
+    q->head = q->tail = 0;
+    q->peak = 0;
+
+    if (depth <= 0) {
+        return CUPKEE_OK;
+    }
+    if (depth > 0x8000) {
+        return -CUPKEE_EINVAL;
+    }
+
+    for (n = 1; n < (uint32_t)depth; n <<= 1)
+        ;
+
+    q->mem = cupkee_malloc(sizeof(eventq_slot_t) * n);
+    if (!q->mem) {
+        return -CUPKEE_ENOMEM;
+    }
+
+    for (i = 0; i < n; i++) {
+        q->mem[i].seq = i;
+    }
+    q->mask = n - 1;
+
+    return CUPKEE_OK;
+}
+
+static void eventq_deinit(eventq_t *q)
+{
+    if (q->mem) {
+        cupkee_free(q->mem);
+        q->mem = NULL;
+    }
+    q->mask = 0;
+    q->head = q->tail = 0;
+}
+
+static inline int eventq_depth(eventq_t *q)
+{
+    return q->mem ? q->mask + 1 : 0;
+}
+
+static inline int eventq_ready(eventq_t *q)
+{
+    return q->mem && __atomic_load_n(&q->mem[q->tail & q->mask].seq, __ATOMIC_ACQUIRE) == q->tail + 1;
+}
+
+static int eventq_has(eventq_t *q, uint8_t type, uint8_t code, uint16_t which)
+{
+    uint32_t data = event_pack(type, code, which);
+    uint32_t pos = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    uint32_t end = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+    for (; pos != end; pos++) {
+        eventq_slot_t *slot = &q->mem[pos & q->mask];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        uint32_t cur = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+
+        // Slot may be taken and refilled while reading, check seq again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq == pos + 1 && cur == data && __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int eventq_push(eventq_t *q, uint8_t type, uint8_t code, uint16_t which)
+{
+    uint32_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    eventq_slot_t *slot;
+    uint32_t cnt, peak;
+
+    if (!q->mem) {
         return 0;
     }
 
-    eventq_mem[pos].type  = type;
-    eventq_mem[pos].code  = code;
-    eventq_mem[pos].which = which;
+    for (;;) {
+        int32_t diff;
+
+        slot = &q->mem[pos & q->mask];
+        diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else
+        if (diff < 0) {
+            return 0;   // full
+        } else {
+            pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&slot->data, event_pack(type, code, which), __ATOMIC_RELAXED);
+#if CUPKEE_EVENT_TRACE
+    slot->stamp = hw_cycle_count();
+#endif
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    cnt = pos + 1 - __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&q->peak, __ATOMIC_RELAXED);
+    while (cnt > peak && cnt <= q->mask + 1) {
+        uint16_t old = peak;
+        if (__atomic_compare_exchange_n(&q->peak, &old, cnt, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+        peak = old;
+    }
 
     return 1;
 }
 
-int cupkee_event_take(cupkee_event_t *e)
+static int eventq_take(eventq_t *q, cupkee_event_t *events, uint32_t *stamps, int max)
 {
-    uint32_t state;
-    int pos;
+    uint32_t pos = q->tail;
+    int n;
+
+    if (!q->mem) {
+        return 0;
+    }
+
+    for (n = 0; n < max; n++, pos++) {
+        eventq_slot_t *slot = &q->mem[pos & q->mask];
+        uint32_t data;
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+            break;
+        }
+        data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+#if CUPKEE_EVENT_TRACE
+        stamps[n] = slot->stamp;
+#else
+        (void) stamps;
+#endif
+        __atomic_store_n(&slot->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+
+        memcpy(&events[n], &data, sizeof(data));
+    }
+    __atomic_store_n(&q->tail, pos, __ATOMIC_RELEASE);
+
+    return n;
+}
 
-    hw_enter_critical(&state);
-    pos = rbuff_shift(&eventq);
-    hw_exit_critical(state);
+#else /* !CUPKEE_EVENTQ_LOCKFREE */
+
+#include "rbuff.h"
+
+typedef struct eventq_t {
+    rbuff_t rb;
+    cupkee_event_t *mem;
+#if CUPKEE_EVENT_TRACE
+    uint32_t *stamp;
+#endif
+    uint16_t peak;
+} eventq_t;
+
+#define eventq_lock(state)      hw_enter_critical(&(state))
+#define eventq_unlock(state)    hw_exit_critical(state)
+
+// Should be called in critical section, as following ones
+static inline void eventq_count(uint32_t *n)
+{
+    (*n)++;
+}
+
+static inline int eventq_flag_set(uint8_t *flag)
+{
+    int old = *flag;
+
+    *flag = 1;
+    return old;
+}
+
+static inline void eventq_flag_clr(uint8_t *flag)
+{
+    *flag = 0;
+}
+
+static int eventq_init(eventq_t *q, int depth)
+{
+    q->mem = NULL;
+    q->peak = 0;
+    rbuff_init(&q->rb, 0);
+
+    if (depth <= 0) {
+        return CUPKEE_OK;
+    }
+    if (depth > 0xFFFF) {
+        return -CUPKEE_EINVAL;
+    }
+
+    q->mem = cupkee_malloc(sizeof(cupkee_event_t) * depth);
+    if (!q->mem) {
+        return -CUPKEE_ENOMEM;
+    }
+#if CUPKEE_EVENT_TRACE
+    q->stamp = cupkee_malloc(sizeof(uint32_t) * depth);
+    if (!q->stamp) {
+        cupkee_free(q->mem);
+        q->mem = NULL;
+        return -CUPKEE_ENOMEM;
+    }
+#endif
+    rbuff_init(&q->rb, depth);
+
+    return CUPKEE_OK;
+}
+
+static void eventq_deinit(eventq_t *q)
+{
+    if (q->mem) {
+        cupkee_free(q->mem);
+        q->mem = NULL;
+    }
+#if CUPKEE_EVENT_TRACE
+    if (q->stamp) {
+        cupkee_free(q->stamp);
+        q->stamp = NULL;
+    }
+#endif
+    rbuff_init(&q->rb, 0);
+}
+
+static inline int eventq_depth(eventq_t *q)
+{
+    return q->rb.size;
+}
+
+static inline int eventq_ready(eventq_t *q)
+{
+    return q->rb.cnt > 0;
+}
+
+static int eventq_has(eventq_t *q, uint8_t type, uint8_t code, uint16_t which)
+{
+    int i;
+
+    for (i = 0; i < q->rb.cnt; i++) {
+        cupkee_event_t *e = &q->mem[_rbuff_get(&q->rb, i)];
+
+        if (e->type == type && e->code == code && e->which == which) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int eventq_push(eventq_t *q, uint8_t type, uint8_t code, uint16_t which)
+{
+    int pos = rbuff_push(&q->rb);
 
     if (pos < 0) {
         return 0;
     }
 
-    *e = eventq_mem[pos];
+    q->mem[pos].type  = type;
+    q->mem[pos].code  = code;
+    q->mem[pos].which = which;
+#if CUPKEE_EVENT_TRACE
+    q->stamp[pos] = hw_cycle_count();
+#endif
+
+    if (q->rb.cnt > q->peak) {
+        q->peak = q->rb.cnt;
+    }
 
     return 1;
 }
 
+static int eventq_take(eventq_t *q, cupkee_event_t *events, uint32_t *stamps, int max)
+{
+    int n, pos;
+
+    for (n = 0; n < max && (pos = rbuff_shift(&q->rb)) >= 0; n++) {
+        events[n] = q->mem[pos];
+#if CUPKEE_EVENT_TRACE
+        stamps[n] = q->stamp[pos];
+#endif
+    }
+    (void) stamps;
+
+    return n;
+}
+
+#endif /* CUPKEE_EVENTQ_LOCKFREE */
+
+static eventq_t eventq_high;
+static eventq_t eventq_low;
+static uint8_t  eventq_flags;
+static uint8_t  eventq_systick;     // systick event is pending
+static uint8_t  eventq_high_run;    // high events taken while low ones wait
+static uint32_t eventq_coalesced;
+static uint32_t eventq_dropped[EVENT_TYPE_MAX];
+static uint8_t  eventq_type_prio[EVENT_TYPE_MAX] = {
+    [EVENT_PIN] = CUPKEE_EVENT_PRIO_HIGH,
+};
+
+#if CUPKEE_EVENT_TRACE
+static uint32_t event_batch_stamp[CUPKEE_EVENT_BATCH];  // post stamp of last batch taken
+static uint32_t event_trace_div;                        // cycles per us
+static cupkee_event_trace_t event_trace_buf[CUPKEE_EVENT_TRACE_SIZE];
+static uint16_t event_trace_head;
+static uint16_t event_trace_num;
+static uint32_t event_trace_lost;
+static cupkee_event_delay_t event_delay[EVENT_TYPE_MAX];
+static uint64_t event_delay_sum[EVENT_TYPE_MAX];
+
+static void event_trace_reset(void)
+{
+    event_trace_div = hw_cycle_freq() / 1000000;
+    if (!event_trace_div) {
+        event_trace_div = 1;
+    }
+
+    event_trace_head = 0;
+    event_trace_num = 0;
+    event_trace_lost = 0;
+
+    memset(event_delay, 0, sizeof(event_delay));
+    memset(event_delay_sum, 0, sizeof(event_delay_sum));
+}
+
+static void event_trace_delay(uint8_t type, uint32_t us)
+{
+    cupkee_event_delay_t *d = &event_delay[type];
+    int i = 0;
+
+    if (d->count == 0 || us < d->min) {
+        d->min = us;
+    }
+    if (us > d->max) {
+        d->max = us;
+    }
+    d->count++;
+    event_delay_sum[type] += us;
+
+    while (i < CUPKEE_EVENT_TRACE_HIST - 1 && (us >> i)) {
+        i++;
+    }
+    d->hist[i]++;
+}
+
+void cupkee_event_trace_dispatch(int i, const cupkee_event_t *e)
+{
+    cupkee_event_trace_t *rec;
+    uint32_t now = hw_cycle_count();
+    uint32_t post = (i >= 0 && i < CUPKEE_EVENT_BATCH) ? event_batch_stamp[i] : now;
+    int tail = event_trace_head + event_trace_num;
+
+    if (e->type < EVENT_TYPE_MAX) {
+        event_trace_delay(e->type, (now - post) / event_trace_div);
+    }
+
+    if (tail >= CUPKEE_EVENT_TRACE_SIZE) {
+        tail -= CUPKEE_EVENT_TRACE_SIZE;
+    }
+    if (event_trace_num < CUPKEE_EVENT_TRACE_SIZE) {
+        event_trace_num++;
+    } else {
+        // Drop the oldest one
+        if (++event_trace_head >= CUPKEE_EVENT_TRACE_SIZE) {
+            event_trace_head = 0;
+        }
+        event_trace_lost++;
+    }
+
+    rec = &event_trace_buf[tail];
+    rec->post = post;
+    rec->dispatch = now;
+    rec->type = e->type;
+    rec->code = e->code;
+    rec->which = e->which;
+}
+
+int cupkee_event_trace_read(cupkee_event_trace_t *rec, int max)
+{
+    int n = 0;
+
+    while (n < max && event_trace_num) {
+        rec[n++] = event_trace_buf[event_trace_head];
+
+        if (++event_trace_head >= CUPKEE_EVENT_TRACE_SIZE) {
+            event_trace_head = 0;
+        }
+        event_trace_num--;
+    }
+
+    return n;
+}
+
+uint32_t cupkee_event_trace_lost(void)
+{
+    return event_trace_lost;
+}
+
+int cupkee_event_delay_get(uint8_t type, cupkee_event_delay_t *delay)
+{
+    if (type >= EVENT_TYPE_MAX) {
+        return -CUPKEE_EINVAL;
+    }
+
+    *delay = event_delay[type];
+    delay->avg = delay->count ? event_delay_sum[type] / delay->count : 0;
+
+    return CUPKEE_OK;
+}
+#else
+static inline void event_trace_reset(void)
+{
+}
+
+void cupkee_event_trace_dispatch(int i, const cupkee_event_t *e)
+{
+    (void) i;
+    (void) e;
+}
+
+int cupkee_event_trace_read(cupkee_event_trace_t *rec, int max)
+{
+    (void) rec;
+    (void) max;
+
+    return 0;
+}
+
+uint32_t cupkee_event_trace_lost(void)
+{
+    return 0;
+}
+
+int cupkee_event_delay_get(uint8_t type, cupkee_event_delay_t *delay)
+{
+    (void) type;
+    (void) delay;
+
+    return -CUPKEE_EIMPLEMENT;
+}
+#endif
+
+void cupkee_event_deinit(void)
+{
+    eventq_deinit(&eventq_low);
+    eventq_deinit(&eventq_high);
+}
+
+int cupkee_event_setup(int depth, int high_depth, int flags)
+{
+    int err;
+
+    if (depth <= 0) {
+        return -CUPKEE_EINVAL;
+    }
+
+    // Setup again, queues of last time are dropped
+    cupkee_event_deinit();
+
+    if (0 != (err = eventq_init(&eventq_low, depth))) {
+        return err;
+    }
+    if (0 != (err = eventq_init(&eventq_high, high_depth))) {
+        eventq_deinit(&eventq_low);
+        return err;
+    }
+
+    eventq_flags = flags;
+    eventq_systick = 0;
+    eventq_high_run = 0;
+    eventq_coalesced = 0;
+    memset(eventq_dropped, 0, sizeof(eventq_dropped));
+    event_trace_reset();
+
+    return CUPKEE_OK;
+}
+
+void cupkee_event_reset(void)
+{
+    cupkee_event_t e;
+
+    while (cupkee_event_take(&e))
+        ;
+}
+
+void cupkee_event_stats(cupkee_event_stat_t *stat)
+{
+    uint32_t state;
+
+    eventq_lock(state);
+    stat->depth = eventq_depth(&eventq_low);
+    stat->peak = eventq_low.peak;
+    stat->high_depth = eventq_depth(&eventq_high);
+    stat->high_peak = eventq_high.peak;
+    stat->coalesced = eventq_coalesced;
+    memcpy(stat->dropped, eventq_dropped, sizeof(eventq_dropped));
+    eventq_unlock(state);
+}
+
+int cupkee_event_prio_set(uint8_t type, int prio)
+{
+    if (type >= EVENT_TYPE_MAX || prio < 0 || prio >= CUPKEE_EVENT_PRIO_MAX) {
+        return -CUPKEE_EINVAL;
+    }
+
+    eventq_type_prio[type] = prio;
+    return CUPKEE_OK;
+}
+
+int cupkee_event_post_prio(int prio, uint8_t type, uint8_t code, uint16_t which)
+{
+    eventq_t *q = &eventq_low;
+    uint32_t state;
+    int systick = type == EVENT_SYSTICK && (eventq_flags & CUPKEE_EVENTQ_COALESCE_SYSTICK);
+    int posted = 1;
+
+    // Without high ring, urgent event goes to the only one
+    if (prio == CUPKEE_EVENT_PRIO_HIGH && eventq_high.mem) {
+        q = &eventq_high;
+    }
+
+    eventq_lock(state);
+
+    if (systick) {
+        if (eventq_flag_set(&eventq_systick)) {
+            eventq_count(&eventq_coalesced);
+            goto DO_END;
+        }
+    } else
+    if ((eventq_flags & CUPKEE_EVENTQ_COALESCE_SAME) && eventq_has(q, type, code, which)) {
+        eventq_count(&eventq_coalesced);
+        goto DO_END;
+    }
+
+    if (!eventq_push(q, type, code, which)) {
+        if (systick) {
+            eventq_flag_clr(&eventq_systick);
+        }
+        eventq_count(&eventq_dropped[type < EVENT_TYPE_MAX ? type : 0]);
+        posted = 0;
+    }
+
+DO_END:
+    eventq_unlock(state);
+
+    return posted;
+}
+
+int cupkee_event_post(uint8_t type, uint8_t code, uint16_t which)
+{
+    return cupkee_event_post_prio(type < EVENT_TYPE_MAX ? eventq_type_prio[type] : CUPKEE_EVENT_PRIO_LOW,
+                                  type, code, which);
+}
+
+int cupkee_event_take_batch(cupkee_event_t *events, int max)
+{
+    uint32_t *stamps = NULL;
+    uint32_t state;
+    int i, n = 0;
+
+#if CUPKEE_EVENT_TRACE
+    stamps = event_batch_stamp;
+    if (max > CUPKEE_EVENT_BATCH) {
+        max = CUPKEE_EVENT_BATCH;
+    }
+#endif
+
+    eventq_lock(state);
+
+    if (eventq_high.mem) {
+        // Starvation guard: let one low event go first after a long high run
+        if (eventq_high_run >= CUPKEE_EVENTQ_HIGH_BURST && max > 0) {
+            n = eventq_take(&eventq_low, events, stamps, 1);
+            eventq_high_run = 0;
+        }
+
+        i = eventq_take(&eventq_high, events + n, stamps ? stamps + n : NULL, max - n);
+        if (i > 0 && eventq_ready(&eventq_low)) {
+            eventq_high_run += i < CUPKEE_EVENTQ_HIGH_BURST ? i : CUPKEE_EVENTQ_HIGH_BURST;
+        } else {
+            eventq_high_run = 0;
+        }
+        n += i;
+    }
+
+    n += eventq_take(&eventq_low, events + n, stamps ? stamps + n : NULL, max - n);
+
+    if (eventq_flags & CUPKEE_EVENTQ_COALESCE_SYSTICK) {
+        for (i = 0; i < n; i++) {
+            if (events[i].type == EVENT_SYSTICK) {
+                eventq_flag_clr(&eventq_systick);
+            }
+        }
+    }
+
+    eventq_unlock(state);
+
+    return n;
+}
+
+int cupkee_event_pending(void)
+{
+    return eventq_ready(&eventq_high) || eventq_ready(&eventq_low);
+}
+
+int cupkee_event_take(cupkee_event_t *e)
+{
+    return cupkee_event_take_batch(e, 1);
+}
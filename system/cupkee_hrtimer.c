@@ -0,0 +1,188 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include "cupkee.h"
+
+/* Active timers in order of expire, shared with timer interrupt */
+static cupkee_hrtimer_t *hrtimer_head = NULL;
+static int hrtimer_ready = 0;
+static int hrtimer_running = 0;
+
+static inline int hrtimer_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void hrtimer_insert(cupkee_hrtimer_t *t)
+{
+    cupkee_hrtimer_t **pp = &hrtimer_head;
+
+    // Same expire keep the order of start
+    while (*pp && !hrtimer_before(t->expire, (*pp)->expire)) {
+        pp = &(*pp)->next;
+    }
+    t->next = *pp;
+    *pp = t;
+    t->active = 1;
+}
+
+static void hrtimer_remove(cupkee_hrtimer_t *t)
+{
+    cupkee_hrtimer_t **pp = &hrtimer_head;
+
+    while (*pp) {
+        if (*pp == t) {
+            *pp = t->next;
+            break;
+        }
+        pp = &(*pp)->next;
+    }
+    t->active = 0;
+}
+
+/* Program alarm for the head, return 0 if head is not expired */
+static int hrtimer_program(void)
+{
+    if (!hrtimer_head) {
+        hw_hrtimer_cancel();
+        return 0;
+    }
+
+    return hw_hrtimer_alarm(hrtimer_head->expire);
+}
+
+void cupkee_hrtimer_setup(void)
+{
+    hrtimer_head = NULL;
+    hrtimer_ready = 0;
+    hrtimer_running = 0;
+}
+
+void cupkee_hrtimer_init(cupkee_hrtimer_t *t, cupkee_hrtimer_handle_t handle, void *param)
+{
+    if (t) {
+        t->next = NULL;
+        t->handle = handle;
+        t->param = param;
+        t->expire = 0;
+        t->period = 0;
+        t->active = 0;
+    }
+}
+
+int cupkee_hrtimer_start(cupkee_hrtimer_t *t, uint32_t us, uint32_t period)
+{
+    uint32_t state;
+    int err = 0;
+
+    if (!t || !t->handle) {
+        return -CUPKEE_EINVAL;
+    }
+
+    // Hardware timer is taken when first used
+    if (!hrtimer_ready) {
+        if (hw_hrtimer_setup()) {
+            return -CUPKEE_EHARDWARE;
+        }
+        hrtimer_ready = 1;
+    }
+
+    hw_enter_critical(&state);
+
+    if (t->active) {
+        hrtimer_remove(t);
+    }
+    t->expire = hw_hrtimer_now() + us;
+    t->period = period;
+    hrtimer_insert(t);
+
+    if (hrtimer_head == t) {
+        err = hrtimer_program();
+    }
+
+    hw_exit_critical(state);
+
+    if (err && !hrtimer_running) {
+        // Passed already, run it now as interrupt does
+        cupkee_hrtimer_expire();
+    }
+
+    return CUPKEE_OK;
+}
+
+int cupkee_hrtimer_stop(cupkee_hrtimer_t *t)
+{
+    uint32_t state;
+    int err = 0;
+
+    if (!t) {
+        return -CUPKEE_EINVAL;
+    }
+
+    hw_enter_critical(&state);
+    if (t->active) {
+        int head = hrtimer_head == t;
+
+        hrtimer_remove(t);
+        if (head) {
+            err = hrtimer_program();
+        }
+    }
+    hw_exit_critical(state);
+
+    if (err && !hrtimer_running) {
+        cupkee_hrtimer_expire();
+    }
+
+    return CUPKEE_OK;
+}
+
+void cupkee_hrtimer_expire(void)
+{
+    uint32_t state;
+
+    hw_enter_critical(&state);
+    hrtimer_running = 1;
+    do {
+        cupkee_hrtimer_t *t;
+        uint32_t now;
+
+        while ((t = hrtimer_head) && !hrtimer_before((now = hw_hrtimer_now()), t->expire)) {
+            hrtimer_head = t->next;
+            t->active = 0;
+
+            if (t->period) {
+                // Keep to the period grid, skip periods missed
+                t->expire += t->period;
+                if (!hrtimer_before(now, t->expire)) {
+                    t->expire += ((now - t->expire) / t->period + 1) * t->period;
+                }
+                hrtimer_insert(t);
+            }
+
+            // Handler may stop or start timers
+            hw_exit_critical(state);
+            t->handle(t, t->param);
+            hw_enter_critical(&state);
+        }
+    } while (hrtimer_program());
+    hrtimer_running = 0;
+    hw_exit_critical(state);
+}
+
@@ -35,15 +35,65 @@
 #define PAGE_MBCQ       (0x20)
 #define PAGE_ZONE_MASK  (0x03)
 
-/* Memory Block Cache queue */
-#define CUPKEE_MBCQ_MAX    (4)
+/* Memory Block Cache queue
+ *
+ * Block size grows about 1.5 times per queue. Each size is a multiple of
+ * CUPKEE_MUNIT_SIZE and large enough to hold a mblock_head_t.
+ */
+#define MBCQ_SIZE_0     (16)
+#define MBCQ_SIZE_1     (24)
+#define MBCQ_SIZE_2     (32)
+#define MBCQ_SIZE_3     (48)
+#define MBCQ_SIZE_4     (64)
+#define MBCQ_SIZE_5     (96)
+#define MBCQ_SIZE_6     (128)
+#define MBCQ_SIZE_7     (192)
+#define MBCQ_SIZE_8     (256)
+#define MBCQ_SIZE_9     (384)
+#define MBCQ_SIZE_10    (512)
+
+#define MBCQ_SIZE_MAX   MBCQ_SIZE_10
+
+#if CUPKEE_PAGE_ORDERR_MAX > 8
+#error "free_map of zone should be wider for CUPKEE_PAGE_ORDERR_MAX"
+#endif
+
+#if CUPKEE_MBCQ_MAX != 11
+#error "CUPKEE_MBCQ_MAX should be the number of MBCQ_SIZE_x"
+#endif
+
+// mbcq_index is written out for 64 + 1 units of 8 bytes
+#if CUPKEE_MUNIT_SHIFT != 3 || MBCQ_SIZE_MAX != 512
+#error "mbcq_index should be regenerated for CUPKEE_MUNIT_SIZE & MBCQ_SIZE_MAX"
+#endif
 
 #define MBLOCK_MAGIC    (0xF1)
-#define MBLOCK_SIZE(b)  (CUPKEE_MUNIT_SIZE << (b))
-
+#define MBLOCK_SIZE(q)  (mbcq_block_size[q])
+
+/* Queue of a block size, used to generate the size to queue map */
+#define MBCQ_OF(s)              \
+    ((s) <= MBCQ_SIZE_0 ? 0 :   \
+     (s) <= MBCQ_SIZE_1 ? 1 :   \
+     (s) <= MBCQ_SIZE_2 ? 2 :   \
+     (s) <= MBCQ_SIZE_3 ? 3 :   \
+     (s) <= MBCQ_SIZE_4 ? 4 :   \
+     (s) <= MBCQ_SIZE_5 ? 5 :   \
+     (s) <= MBCQ_SIZE_6 ? 6 :   \
+     (s) <= MBCQ_SIZE_7 ? 7 :   \
+     (s) <= MBCQ_SIZE_8 ? 8 :   \
+     (s) <= MBCQ_SIZE_9 ? 9 : 10)
+
+#define MBCQ_OF_UNIT(u)         MBCQ_OF((u) * CUPKEE_MUNIT_SIZE)
+#define MBCQ_OF_UNIT8(u)        \
+    MBCQ_OF_UNIT(u + 0), MBCQ_OF_UNIT(u + 1), MBCQ_OF_UNIT(u + 2), MBCQ_OF_UNIT(u + 3), \
+    MBCQ_OF_UNIT(u + 4), MBCQ_OF_UNIT(u + 5), MBCQ_OF_UNIT(u + 6), MBCQ_OF_UNIT(u + 7)
+
+/* Bit n of free_map is set, if pages_free[n] is not empty */
 typedef struct cupkee_zone_t {
     intptr_t base;
     uint32_t page_num;
+    uint8_t  prefer;
+    uint8_t  free_map;
     list_head_t   pages_free[CUPKEE_PAGE_ORDERR_MAX];
     cupkee_page_t pages[0];
 } cupkee_zone_t;
@@ -53,10 +103,69 @@ typedef struct mblock_head_t {
     intptr_t comp;
 } mblock_head_t;
 
+/* Pages of a block cache queue are kept in three lists:
+ *   partial: some blocks are free, the allocation source
+ *   full:    no free block
+ *   empty:   all blocks are free, up to empty_max pages are cached there
+ *            instead of going back to buddy system at once
+ */
+typedef struct mbcq_t {
+    list_head_t partial;
+    list_head_t full;
+    list_head_t empty;
+    uint8_t     empty_num;
+    uint8_t     empty_max;
+    uint32_t    page_num;
+    uint32_t    block_used;
+} mbcq_t;
+
+static const uint16_t mbcq_block_size[CUPKEE_MBCQ_MAX] = {
+    MBCQ_SIZE_0, MBCQ_SIZE_1, MBCQ_SIZE_2, MBCQ_SIZE_3,
+    MBCQ_SIZE_4, MBCQ_SIZE_5, MBCQ_SIZE_6, MBCQ_SIZE_7,
+    MBCQ_SIZE_8, MBCQ_SIZE_9, MBCQ_SIZE_10
+};
+
+/* Queue index, indexed by size in units: (size + CUPKEE_MUNIT_SIZE - 1) >> CUPKEE_MUNIT_SHIFT
+ * Note: the table should be regenerated, if MBCQ_SIZE_MAX or CUPKEE_MUNIT_SIZE changed,
+ * which is checked above.
+ */
+static const uint8_t mbcq_index[MBCQ_SIZE_MAX / CUPKEE_MUNIT_SIZE + 1] = {
+    MBCQ_OF_UNIT8(0),  MBCQ_OF_UNIT8(8),  MBCQ_OF_UNIT8(16), MBCQ_OF_UNIT8(24),
+    MBCQ_OF_UNIT8(32), MBCQ_OF_UNIT8(40), MBCQ_OF_UNIT8(48), MBCQ_OF_UNIT8(56),
+    MBCQ_OF_UNIT(64)
+};
+
+/* Page memory range of zone, kept apart from zone head which may be in
+ * slow external memory, to find zone of pointer quickly.
+ */
+typedef struct memory_range_t {
+    uintptr_t base;
+    uintptr_t size;
+} memory_range_t;
+
 static uint8_t memory_zone_num = 0;
 
 static cupkee_zone_t *memory_zone[CUPKEE_ZONE_MAX];
-static list_head_t    memory_mbcq[CUPKEE_MBCQ_MAX];
+static memory_range_t memory_range[CUPKEE_ZONE_MAX];
+static uint8_t        memory_zone_order[CUPKEE_ZONE_MAX];
+static mbcq_t         memory_mbcq[CUPKEE_MBCQ_MAX];
+
+// Buddy operations avoided by empty page cache
+static uint32_t memory_cache_kept;
+static uint32_t memory_cache_reused;
+
+// Statistics, maintained on the fly
+static uint32_t memory_free_num[CUPKEE_PAGE_ORDERR_MAX];
+static uint32_t memory_bytes_used;
+static uint32_t memory_bytes_peak;
+static uint32_t memory_alloc_fails;
+
+#if CUPKEE_MEMORY_TRACE
+static cupkee_memory_trace_t memory_trace_buf[CUPKEE_MEMORY_TRACE_SIZE];
+static uint16_t memory_trace_head;
+static uint16_t memory_trace_num;
+static uint32_t memory_trace_lost;
+#endif
 
 static inline size_t zone_block_size(int pages)
 {
@@ -69,14 +178,42 @@ static inline cupkee_zone_t *page_zone(cupkee_page_t *page) {
     return id < memory_zone_num ? memory_zone[id] : NULL;
 }
 
-static int page_clip(int page_num, uint16_t *order)
+static inline void zone_free_add(cupkee_zone_t *zone, cupkee_page_t *page)
+{
+    list_add(&page->list, &zone->pages_free[page->order]);
+    zone->free_map |= 1 << page->order;
+    memory_free_num[page->order]++;
+}
+
+static inline void zone_free_del(cupkee_zone_t *zone, cupkee_page_t *page)
+{
+    list_del(&page->list);
+    if (list_is_empty(&zone->pages_free[page->order])) {
+        zone->free_map &= ~(1 << page->order);
+    }
+    memory_free_num[page->order]--;
+}
+
+static inline void memory_bytes_inc(size_t n)
+{
+    memory_bytes_used += n;
+    if (memory_bytes_used > memory_bytes_peak) {
+        memory_bytes_peak = memory_bytes_used;
+    }
+}
+
+// Page level, not counted in bytes used
+static cupkee_page_t *page_take(int order);
+static void page_give(cupkee_page_t *page);
+
+static int page_clip(int page_num, uint8_t *order)
 {
     int i;
 
     for (i = CUPKEE_PAGE_ORDERR_MAX - 1; i >= 0; i--) {
         int n = 1 << i;
         if (page_num >= n) {
-            *order = (uint16_t)i;
+            *order = (uint8_t)i;
             return n;
         }
     }
@@ -89,7 +226,7 @@ static int zone_init(cupkee_zone_t *zone, intptr_t page_base, int page_num)
     int i;
 
     if (memory_zone_num >= CUPKEE_ZONE_MAX) {
-        return -1;
+        return -CUPKEE_ERESOURCE;
     }
 
     memset(zone, 0, sizeof(cupkee_zone_t));
@@ -101,6 +238,7 @@ static int zone_init(cupkee_zone_t *zone, intptr_t page_base, int page_num)
         zone->pages[i].flags = memory_zone_num;
         zone->pages[i].used  = 0;
         zone->pages[i].order = 0;
+        zone->pages[i].mbcq  = 0;
 
         zone->pages[i].blocks = 0;
 
@@ -108,14 +246,14 @@ static int zone_init(cupkee_zone_t *zone, intptr_t page_base, int page_num)
     }
 
     while (page_num > page_off) {
-        uint16_t order;
+        uint8_t order;
         int pages = page_clip(page_num - page_off, &order);
 
         if (pages) {
             zone->pages[page_off].flags |= PAGE_HEAD;
             zone->pages[page_off].order = order;
 
-            list_add(&zone->pages[page_off].list, &zone->pages_free[order]);
+            zone_free_add(zone, &zone->pages[page_off]);
 
             page_off += pages;
         } else {
@@ -125,28 +263,68 @@ static int zone_init(cupkee_zone_t *zone, intptr_t page_base, int page_num)
 
     zone->base = page_base;
     zone->page_num = page_num;
+    zone->prefer = 0;
 
-    memory_zone[memory_zone_num++] = zone;
+    memory_range[memory_zone_num].base = page_base;
+    memory_range[memory_zone_num].size = page_num * CUPKEE_PAGE_SIZE;
+    memory_zone_order[memory_zone_num] = memory_zone_num;
 
-    return 0;
+    memory_zone[memory_zone_num] = zone;
+
+    return memory_zone_num++;
+}
+
+static int zone_create(intptr_t mem_base, size_t mem_size)
+{
+    intptr_t mem_end = mem_base + mem_size;
+    intptr_t zone_base;
+    intptr_t page_base;
+    size_t   zone_size;
+
+    zone_base = (intptr_t) CUPKEE_ADDR_ALIGN(mem_base, sizeof(intptr_t));
+    zone_size = zone_block_size(mem_size / CUPKEE_PAGE_SIZE);
+
+    // printf("zone block size: %lu = %lu + %lu * %lu\n", zone_size, sizeof(cupkee_zone_t), sizeof(cupkee_page_t), mem_size / CUPKEE_PAGE_SIZE);
+
+    page_base = (intptr_t) CUPKEE_ADDR_ALIGN((zone_base + zone_size), CUPKEE_PAGE_SIZE);
+    if (page_base + (intptr_t)CUPKEE_PAGE_SIZE > mem_end) {
+        return -CUPKEE_EINVAL;
+    }
+
+    // printf("page base: %p, size: %lu\n", page_base, mem_end - page_base);
+
+    return zone_init((cupkee_zone_t *) zone_base, page_base, (mem_end - page_base) / CUPKEE_PAGE_SIZE);
 }
 
 int cupkee_memory_setup(void)
 {
     size_t mem_size;
-    size_t zone_size;
-    size_t page_size;
     intptr_t mem_base;
-    intptr_t mem_end;
-    intptr_t zone_base;
-    intptr_t page_base;
-    cupkee_zone_t *zone;
     int i;
 
     memory_zone_num = 0;
     for (i = 0; i < CUPKEE_MBCQ_MAX; i++) {
-        list_head_init(&memory_mbcq[i]);
+        list_head_init(&memory_mbcq[i].partial);
+        list_head_init(&memory_mbcq[i].full);
+        list_head_init(&memory_mbcq[i].empty);
+        memory_mbcq[i].empty_num = 0;
+        memory_mbcq[i].empty_max = CUPKEE_MBCQ_CACHE_DEF;
+        memory_mbcq[i].page_num = 0;
+        memory_mbcq[i].block_used = 0;
     }
+    memory_cache_kept = 0;
+    memory_cache_reused = 0;
+
+    memset(memory_free_num, 0, sizeof(memory_free_num));
+    memory_bytes_used = 0;
+    memory_bytes_peak = 0;
+    memory_alloc_fails = 0;
+
+#if CUPKEE_MEMORY_TRACE
+    memory_trace_head = 0;
+    memory_trace_num = 0;
+    memory_trace_lost = 0;
+#endif
 
     /* boot zone init */
     mem_size = hw_memory_size();
@@ -154,46 +332,68 @@ int cupkee_memory_setup(void)
     if (!mem_base) {
         return -1;
     }
-    mem_end = mem_base + mem_size;
 
-    zone_base = (intptr_t) CUPKEE_ADDR_ALIGN(mem_base, sizeof(intptr_t));
-    zone_size = zone_block_size(mem_size / CUPKEE_PAGE_SIZE);
-
-    // printf("zone block size: %lu = %lu + %lu * %lu\n", zone_size, sizeof(cupkee_zone_t), sizeof(cupkee_page_t), mem_size / CUPKEE_PAGE_SIZE);
+    return zone_create(mem_base, mem_size) < 0 ? -1 : 0;
+}
 
-    page_base = (intptr_t) CUPKEE_ADDR_ALIGN((zone_base + zone_size), CUPKEE_PAGE_SIZE);
-    page_size = mem_end - page_base;
+int cupkee_memory_extend(intptr_t base, size_t size)
+{
+    uintptr_t end = (uintptr_t)base + size;
+    int i;
 
-    // printf("page base: %p, size: %lu\n", page_base, page_size);
+    if (!base || end < (uintptr_t)base) {
+        return -CUPKEE_EINVAL;
+    }
 
-    zone = (cupkee_zone_t *) zone_base;
+    // Overlapped with exist zone ?
+    for (i = 0; i < memory_zone_num; i++) {
+        if ((uintptr_t)base < memory_range[i].base + memory_range[i].size &&
+            end > (uintptr_t)memory_zone[i]) {
+            return -CUPKEE_EINVAL;
+        }
+    }
 
-    return zone_init(zone, page_base, page_size / CUPKEE_PAGE_SIZE);
+    return zone_create(base, size);
 }
 
-int cupkee_memory_extend(intptr_t base, size_t size)
+int cupkee_memory_prefer(int zone_id, int prefer)
 {
-    (void) base;
-    (void) size;
+    int i, j;
+
+    if ((unsigned)zone_id >= memory_zone_num || prefer < 0 || prefer > 255) {
+        return -CUPKEE_EINVAL;
+    }
+    memory_zone[zone_id]->prefer = prefer;
+
+    // Keep zones sorted by prefer, first registered first at same prefer
+    for (i = 0; i < memory_zone_num; i++) {
+        memory_zone_order[i] = i;
+        for (j = i; j > 0; j--) {
+            int a = memory_zone_order[j - 1];
+            int b = memory_zone_order[j];
+
+            if (memory_zone[a]->prefer >= memory_zone[b]->prefer) {
+                break;
+            }
+            memory_zone_order[j - 1] = b;
+            memory_zone_order[j] = a;
+        }
+    }
 
-    return -1;
+    return CUPKEE_OK;
 }
 
 cupkee_page_t *cupkee_memory_page(void *ptr)
 {
-    cupkee_zone_t *zone;
-    intptr_t page_base = (intptr_t) ptr;
+    uintptr_t addr = (uintptr_t) ptr;
     int i;
 
+    // Only CUPKEE_ZONE_MAX ranges, no zone head access
     for (i = 0; i < memory_zone_num; i++) {
-        zone = memory_zone[i];
-
-        if (page_base >= zone->base) {
-            unsigned id = (page_base - zone->base) >> CUPKEE_PAGE_SHIFT;
+        uintptr_t off = addr - memory_range[i].base;
 
-            if (id < zone->page_num) {
-                return &zone->pages[id];
-            }
+        if (off < memory_range[i].size) {
+            return &memory_zone[i]->pages[off >> CUPKEE_PAGE_SHIFT];
         }
     }
 
@@ -216,24 +416,11 @@ void *cupkee_page_memory(cupkee_page_t *page)
 
 int cupkee_free_pages(int order)
 {
-    int count = 0;
-    int i;
-
-    if (order >= CUPKEE_PAGE_ORDERR_MAX) {
+    if ((unsigned)order >= CUPKEE_PAGE_ORDERR_MAX) {
         return 0;
     }
 
-    for (i = 0; i < memory_zone_num; i++) {
-        list_head_t *pos;
-        list_head_t *head = &memory_zone[i]->pages_free[order];
-
-        list_for_each(pos, head) {
-            count++;
-        }
-    }
-    // printf("free page: %d\n", count);
-
-    return count;
+    return memory_free_num[order];
 }
 
 static cupkee_page_t *page_division(cupkee_page_t *page)
@@ -255,10 +442,9 @@ static cupkee_page_t *page_division(cupkee_page_t *page)
     return buddy;
 }
 
-static cupkee_page_t *page_combine(cupkee_page_t *page, cupkee_zone_t *zone)
+static cupkee_page_t *page_buddy(cupkee_page_t *page, cupkee_zone_t *zone, int order)
 {
     cupkee_page_t *buddy;
-    int order = page->order;
     int pos, dis;
 
     pos = page - zone->pages;
@@ -266,7 +452,7 @@ static cupkee_page_t *page_combine(cupkee_page_t *page, cupkee_zone_t *zone)
         return NULL;
     }
 
-    if ((pos >> (page->order)) & 1) {
+    if ((pos >> order) & 1) {
         dis = -(1 << order);
     } else {
         dis = 1 << order;
@@ -276,12 +462,25 @@ static cupkee_page_t *page_combine(cupkee_page_t *page, cupkee_zone_t *zone)
     }
 
     buddy = page + dis;
-    if ((buddy->flags & PAGE_INUSED) || (buddy->order != page->order)) {
+    if ((buddy->flags & PAGE_INUSED) || (buddy->order != order)) {
         return NULL;
     }
-    list_del(&buddy->list);
 
-    if (dis < 0) {
+    return buddy;
+}
+
+static cupkee_page_t *page_combine(cupkee_page_t *page, cupkee_zone_t *zone)
+{
+    cupkee_page_t *buddy;
+    int order = page->order;
+
+    buddy = page_buddy(page, zone, order);
+    if (!buddy) {
+        return NULL;
+    }
+    zone_free_del(zone, buddy);
+
+    if (buddy < page) {
         page->flags &= ~PAGE_HEAD;
 
         buddy->order = order + 1;
@@ -294,52 +493,82 @@ static cupkee_page_t *page_combine(cupkee_page_t *page, cupkee_zone_t *zone)
     }
 }
 
-static cupkee_page_t *zone_page_alloc(cupkee_zone_t *zone, int order)
+/* Grow inused page to order, by absorbing the free buddies behind it.
+ * Nothing is changed, if any one of them is not free.
+ */
+static int page_expand(cupkee_page_t *page, cupkee_zone_t *zone, int order)
 {
-    cupkee_page_t *page;
-    int supor;
+    cupkee_page_t *buddy;
+    int o;
 
+    for (o = page->order; o < order; o++) {
+        buddy = page_buddy(page, zone, o);
+        if (!buddy || buddy < page) {
+            return 0;
+        }
+    }
 
-    if (!list_is_empty(&zone->pages_free[order])) {
-        page = (cupkee_page_t *)(zone->pages_free[order].next);
+    while (page->order < order) {
+        buddy = page + (1 << page->order);
 
-        list_del(&page->list);
+        zone_free_del(zone, buddy);
+        buddy->flags &= ~PAGE_HEAD;
+        page->order++;
+    }
 
-        page->flags |= PAGE_INUSED;
+    return 1;
+}
 
-        return page;
+/* Shrink inused page to order, the cut off tail is given back to zone */
+static void page_shrink(cupkee_page_t *page, int order)
+{
+    while (page->order > order) {
+        cupkee_page_t *buddy = page_division(page);
+
+        if (!buddy) {
+            return;
+        }
+        page_give(buddy);
     }
+}
 
-    for (supor = order + 1; supor < CUPKEE_PAGE_ORDERR_MAX; supor ++) {
-        if(!list_is_empty(&zone->pages_free[supor])) {
-            page = (cupkee_page_t *)(zone->pages_free[supor].next);
-            list_del(&page->list);
-            while (page->order != order) {
-                cupkee_page_t *buddy = page_division(page);
-                if (!buddy) {
-                    return NULL;
-                }
+static cupkee_page_t *zone_page_alloc(cupkee_zone_t *zone, int order)
+{
+    cupkee_page_t *page;
+    unsigned map = zone->free_map & ~((1U << order) - 1);
 
-                list_add(&buddy->list, &zone->pages_free[buddy->order]);
-            }
+    if (!map) {
+        return NULL;
+    }
 
-            page->flags |= PAGE_INUSED;
+    // Smallest order which has free pages
+    page = (cupkee_page_t *)(zone->pages_free[__builtin_ctz(map)].next);
+    zone_free_del(zone, page);
 
-            return page;
+    while (page->order != order) {
+        cupkee_page_t *buddy = page_division(page);
+        if (!buddy) {
+            return NULL;
         }
+
+        zone_free_add(zone, buddy);
     }
 
-    return NULL;
+    page->flags |= PAGE_INUSED;
+
+    return page;
 }
 
-static void page_block_init(cupkee_page_t *page, size_t block_size)
+static void page_block_init(cupkee_page_t *page, int q)
 {
     void *mem = cupkee_page_memory(page);
+    size_t block_size = MBLOCK_SIZE(q);
     int i, max = CUPKEE_PAGE_SIZE / block_size;
     intptr_t head = 0;
 
     page->flags |= PAGE_MBCQ;
     page->used   = 0;
+    page->mbcq   = q;
 
     for (i = 0; i < max; i++) {
         mblock_head_t *mb = (mblock_head_t *)(mem + block_size * i);
@@ -366,80 +595,230 @@ static void *page_block_alloc(cupkee_page_t *page)
     return mb;
 }
 
+static inline void mbcq_page_move(cupkee_page_t *page, list_head_t *head)
+{
+    list_del(&page->list);
+    list_add(&page->list, head);
+}
+
 static void page_block_free(cupkee_page_t *page, void *b)
 {
     mblock_head_t *mb = (mblock_head_t *)b;
+    mbcq_t *mbcq = &memory_mbcq[page->mbcq];
+    int was_full = !page->blocks;
 
     mb->next = page->blocks;
     mb->comp = ~(mb->next) + 1;
 
     page->blocks = (intptr_t) mb;
+
+    mbcq->block_used--;
+    memory_bytes_used -= MBLOCK_SIZE(page->mbcq);
+
     if (--page->used == 0) {
+        if (mbcq->empty_num < mbcq->empty_max) {
+            mbcq_page_move(page, &mbcq->empty);
+            mbcq->empty_num++;
+            memory_cache_kept++;
+        } else {
+            list_del(&page->list);
+            page_give(page);
+            mbcq->page_num--;
+        }
+    } else
+    if (was_full) {
+        // Keep filling the head page, let this one wait at the tail
         list_del(&page->list);
-        cupkee_page_free(page);
+        list_add_tail(&page->list, &mbcq->partial);
     }
 }
 
-static inline cupkee_page_t *mbcq_page_first(int q)
+static cupkee_page_t *mbcq_page_get(int q)
 {
-    list_head_t *head = &memory_mbcq[q];
+    mbcq_t *mbcq = &memory_mbcq[q];
+    cupkee_page_t *page;
 
-    return list_is_empty(head) ? NULL : (cupkee_page_t *)(head->next);
+    if (!list_is_empty(&mbcq->partial)) {
+        return (cupkee_page_t *)(mbcq->partial.next);
+    }
+
+    if (!list_is_empty(&mbcq->empty)) {
+        page = (cupkee_page_t *)(mbcq->empty.next);
+        mbcq_page_move(page, &mbcq->partial);
+        mbcq->empty_num--;
+        memory_cache_reused++;
+        return page;
+    }
+
+    page = page_take(0);
+    if (page) {
+        page_block_init(page, q);
+        list_add(&page->list, &mbcq->partial);
+        mbcq->page_num++;
+    }
+
+    return page;
 }
 
 static void *mbcq_alloc(size_t size)
+{
+    int q = mbcq_index[(size + CUPKEE_MUNIT_SIZE - 1) >> CUPKEE_MUNIT_SHIFT];
+
+    while (q < CUPKEE_MBCQ_MAX) {
+        cupkee_page_t *page = mbcq_page_get(q);
+        void *b;
+
+        if (!page) {
+            q++;
+            continue;
+        }
+
+        b = page_block_alloc(page);
+        if (!page->blocks) {
+            mbcq_page_move(page, &memory_mbcq[q].full);
+        }
+
+        memory_mbcq[q].block_used++;
+        memory_bytes_inc(MBLOCK_SIZE(q));
+
+        return b;
+    }
+
+    return NULL;
+}
+
+static int mbcq_cache_trim(mbcq_t *mbcq, int keep)
+{
+    int n = 0;
+
+    while (mbcq->empty_num > keep) {
+        cupkee_page_t *page = (cupkee_page_t *)(mbcq->empty.next);
+
+        list_del(&page->list);
+        page_give(page);
+
+        mbcq->empty_num--;
+        mbcq->page_num--;
+        n++;
+    }
+
+    return n;
+}
+
+static cupkee_page_t *memory_page_alloc(int order)
+{
+    int zone_id;
+    cupkee_page_t *page;
+
+    for (zone_id = 0, page = NULL; !page && zone_id < memory_zone_num; zone_id++) {
+        page = zone_page_alloc(memory_zone[memory_zone_order[zone_id]], order);
+    }
+
+    return page;
+}
+
+int cupkee_memory_reclaim(void)
+{
+    int q, n = 0;
+
+    for (q = 0; q < CUPKEE_MBCQ_MAX; q++) {
+        n += mbcq_cache_trim(&memory_mbcq[q], 0);
+    }
+
+    return n;
+}
+
+int cupkee_memory_cache_set(size_t size, int pages)
 {
     int q;
 
-    if (size > MBLOCK_SIZE(2)) {
-        q = 3;
+    if (size > MBCQ_SIZE_MAX || pages < 0 || pages > 255) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (size) {
+        q = mbcq_index[(size + CUPKEE_MUNIT_SIZE - 1) >> CUPKEE_MUNIT_SHIFT];
+
+        memory_mbcq[q].empty_max = pages;
+        mbcq_cache_trim(&memory_mbcq[q], pages);
     } else {
-    if (size > MBLOCK_SIZE(1)) {
-        q = 2;
-    } else
-    if (size > MBLOCK_SIZE(0)) {
-        q = 1;
-    } else
-        q = 0;
+        for (q = 0; q < CUPKEE_MBCQ_MAX; q++) {
+            memory_mbcq[q].empty_max = pages;
+            mbcq_cache_trim(&memory_mbcq[q], pages);
+        }
     }
 
-    while (q < CUPKEE_MBCQ_MAX) {
-        cupkee_page_t *page = mbcq_page_first(q);
+    return CUPKEE_OK;
+}
 
-        if (!page || !page->blocks) {
-            page = cupkee_page_alloc(0);
-            if (page) {
-                page_block_init(page, MBLOCK_SIZE(q));
-                list_add(&page->list, &memory_mbcq[q]);
-            } else {
-                q++;
-                continue;
-            }
+void cupkee_memory_cache_stat(uint32_t *kept, uint32_t *reused)
+{
+    if (kept) {
+        *kept = memory_cache_kept;
+    }
+    if (reused) {
+        *reused = memory_cache_reused;
+    }
+}
+
+int cupkee_memory_stats(cupkee_memory_stat_t *stat)
+{
+    int i;
+
+    if (!stat) {
+        return -CUPKEE_EINVAL;
+    }
+
+    stat->free_bytes = 0;
+    stat->largest_free = 0;
+    for (i = 0; i < CUPKEE_PAGE_ORDERR_MAX; i++) {
+        stat->free_pages[i] = memory_free_num[i];
+        if (memory_free_num[i]) {
+            stat->free_bytes  += (uint32_t)memory_free_num[i] * (CUPKEE_PAGE_SIZE << i);
+            stat->largest_free = CUPKEE_PAGE_SIZE << i;
         }
+    }
 
-        return page_block_alloc(page);
+    for (i = 0; i < CUPKEE_MBCQ_MAX; i++) {
+        stat->mbcq_size[i]   = MBLOCK_SIZE(i);
+        stat->mbcq_pages[i]  = memory_mbcq[i].page_num;
+        stat->mbcq_blocks[i] = memory_mbcq[i].block_used;
     }
 
-    return NULL;
+    stat->bytes_used   = memory_bytes_used;
+    stat->bytes_peak   = memory_bytes_peak;
+    stat->alloc_fails  = memory_alloc_fails;
+    stat->cache_kept   = memory_cache_kept;
+    stat->cache_reused = memory_cache_reused;
+
+    // Fragmentation index: how much of free memory not in the largest block
+    if (stat->free_bytes) {
+        stat->fragment = 100 - (uint64_t)stat->largest_free * 100 / stat->free_bytes;
+    } else {
+        stat->fragment = 0;
+    }
+
+    return CUPKEE_OK;
 }
 
-cupkee_page_t *cupkee_page_alloc(int order)
+static cupkee_page_t *page_take(int order)
 {
-    int zone_id;
     cupkee_page_t *page;
 
     if (order >= CUPKEE_PAGE_ORDERR_MAX) {
         return NULL;
     }
 
-    for (zone_id = 0, page = NULL; !page && zone_id < memory_zone_num; zone_id++) {
-        page = zone_page_alloc(memory_zone[zone_id], order);
+    page = memory_page_alloc(order);
+    if (!page && cupkee_memory_reclaim()) {
+        // Under memory pressure, try again with the cached pages released
+        page = memory_page_alloc(order);
     }
 
     return page;
 }
 
-void cupkee_page_free(cupkee_page_t *page)
+static void page_give(cupkee_page_t *page)
 {
     cupkee_page_t *super;
     cupkee_zone_t *zone = page_zone(page);
@@ -458,21 +837,128 @@ void cupkee_page_free(cupkee_page_t *page)
 
     // printf("real free: %d, %u\n", page - zone->pages, page->order);
 
-    list_add(&page->list, &zone->pages_free[page->order]);
+    zone_free_add(zone, page);
 }
 
-void *cupkee_malloc(size_t size)
+/* Pages taken directly, as by arena, are counted in bytes used too */
+cupkee_page_t *cupkee_page_alloc(int order)
+{
+    cupkee_page_t *page = page_take(order);
+
+    if (page) {
+        memory_bytes_inc(CUPKEE_PAGE_SIZE << page->order);
+    }
+    return page;
+}
+
+void cupkee_page_free(cupkee_page_t *page)
+{
+    if (page && page_zone(page)) {
+        memory_bytes_used -= CUPKEE_PAGE_SIZE << page->order;
+        page_give(page);
+    }
+}
+
+#if CUPKEE_MEMORY_TRACE
+static void memory_trace(int op, size_t size, void *ptr, void *prev)
 {
-    if (size <= MBLOCK_SIZE(CUPKEE_MBCQ_MAX - 1)) {
-        return mbcq_alloc(size);
+    cupkee_memory_trace_t *rec;
+    cupkee_page_t *page = cupkee_memory_page(ptr);
+    int tail = memory_trace_head + memory_trace_num;
+
+    if (tail >= CUPKEE_MEMORY_TRACE_SIZE) {
+        tail -= CUPKEE_MEMORY_TRACE_SIZE;
+    }
+
+    if (memory_trace_num < CUPKEE_MEMORY_TRACE_SIZE) {
+        memory_trace_num++;
     } else {
-        int order = 0;
+        // Drop the oldest one
+        if (++memory_trace_head >= CUPKEE_MEMORY_TRACE_SIZE) {
+            memory_trace_head = 0;
+        }
+        memory_trace_lost++;
+    }
 
-        while (size > (CUPKEE_PAGE_SIZE << order)) {
-            if (++order >= CUPKEE_PAGE_ORDERR_MAX) {
-                break;
-            }
+    rec = &memory_trace_buf[tail];
+    rec->tick = _cupkee_systicks;
+    rec->size = size;
+    rec->ptr  = (uintptr_t)ptr;
+    rec->prev = (uintptr_t)prev;
+    rec->op   = op;
+    if (page) {
+        rec->order = (page->flags & PAGE_MBCQ) ? CUPKEE_TRACE_ORDER_BLOCK : page->order;
+    } else {
+        rec->order = 0;
+    }
+}
+
+int cupkee_memory_trace_read(cupkee_memory_trace_t *rec, int max)
+{
+    int n = 0;
+
+    while (n < max && memory_trace_num) {
+        rec[n++] = memory_trace_buf[memory_trace_head];
+
+        if (++memory_trace_head >= CUPKEE_MEMORY_TRACE_SIZE) {
+            memory_trace_head = 0;
+        }
+        memory_trace_num--;
+    }
+
+    return n;
+}
+
+uint32_t cupkee_memory_trace_lost(void)
+{
+    return memory_trace_lost;
+}
+#else
+static inline void memory_trace(int op, size_t size, void *ptr, void *prev)
+{
+    (void) op;
+    (void) size;
+    (void) ptr;
+    (void) prev;
+}
+
+int cupkee_memory_trace_read(cupkee_memory_trace_t *rec, int max)
+{
+    (void) rec;
+    (void) max;
+
+    return 0;
+}
+
+uint32_t cupkee_memory_trace_lost(void)
+{
+    return 0;
+}
+#endif
+
+static int memory_order(size_t size)
+{
+    int order = 0;
+
+    while (size > (CUPKEE_PAGE_SIZE << order)) {
+        if (++order >= CUPKEE_PAGE_ORDERR_MAX) {
+            break;
         }
+    }
+
+    return order;
+}
+
+static void *memory_alloc(size_t size)
+{
+    if (size <= MBCQ_SIZE_MAX) {
+        void *b = mbcq_alloc(size);
+
+        if (b) {
+            return b;
+        }
+    } else {
+        int order = memory_order(size);
 
         while (order < CUPKEE_PAGE_ORDERR_MAX) {
             cupkee_page_t *page = cupkee_page_alloc(order++);
@@ -483,10 +969,12 @@ void *cupkee_malloc(size_t size)
         }
     }
 
+    memory_alloc_fails++;
+
     return NULL;
 }
 
-void  cupkee_free(void *p)
+static void memory_free(void *p)
 {
     cupkee_page_t *page = cupkee_memory_page(p);
 
@@ -502,3 +990,83 @@ void  cupkee_free(void *p)
     }
 }
 
+static void *memory_realloc(void *p, size_t size)
+{
+    cupkee_page_t *page;
+    size_t old_size;
+    void *n;
+
+    if (!p) {
+        return memory_alloc(size);
+    }
+
+    if (!size) {
+        memory_free(p);
+        return NULL;
+    }
+
+    page = cupkee_memory_page(p);
+    if (!page) {
+        return NULL;
+    }
+
+    if (page->flags & PAGE_MBCQ) {
+        old_size = MBLOCK_SIZE(page->mbcq);
+        if (size <= old_size) {
+            return p;
+        }
+    } else {
+        int old_order = page->order;
+        int order = memory_order(size);
+
+        old_size = CUPKEE_PAGE_SIZE << old_order;
+        if (order < old_order) {
+            page_shrink(page, order);
+            memory_bytes_used -= old_size - (CUPKEE_PAGE_SIZE << page->order);
+            return p;
+        }
+
+        if (order == old_order) {
+            return p;
+        }
+
+        if (order < CUPKEE_PAGE_ORDERR_MAX && page_expand(page, page_zone(page), order)) {
+            memory_bytes_inc((CUPKEE_PAGE_SIZE << order) - old_size);
+            return p;
+        }
+    }
+
+    // Last resort: move to new memory
+    n = memory_alloc(size);
+    if (n) {
+        memcpy(n, p, old_size);
+        memory_free(p);
+    }
+
+    return n;
+}
+
+void *cupkee_malloc(size_t size)
+{
+    void *p = memory_alloc(size);
+
+    memory_trace(CUPKEE_TRACE_ALLOC, size, p, NULL);
+
+    return p;
+}
+
+void cupkee_free(void *p)
+{
+    memory_trace(CUPKEE_TRACE_FREE, 0, p, NULL);
+
+    memory_free(p);
+}
+
+void *cupkee_realloc(void *p, size_t size)
+{
+    void *n = memory_realloc(p, size);
+
+    memory_trace(CUPKEE_TRACE_REALLOC, size, n, p);
+
+    return n;
+}
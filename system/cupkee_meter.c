@@ -0,0 +1,124 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include "cupkee.h"
+
+#if CUPKEE_METER
+
+#define METER_SLOT_TICKS    (CUPKEE_METER_SLOT_MS * SYSTEM_TICKS_PRE_SEC / 1000)
+
+/* Slot is bounded by systicks: cycle counter may wrap in a long idle,
+ * cycles are only taken for time of items and iterations.
+ */
+typedef struct meter_slot_t {
+    uint32_t ticks;         // length of slot
+    uint32_t loops;
+    uint32_t idle;
+    uint32_t loop_max;      // cycles
+    uint32_t time[CUPKEE_METER_ITEM_MAX];
+} meter_slot_t;
+
+static meter_slot_t meter_slots[CUPKEE_METER_SLOTS + 1];   // finished ones and current
+static uint8_t  meter_curr;
+static uint8_t  meter_full;     // number of slots finished, up to CUPKEE_METER_SLOTS
+static uint32_t meter_begin;    // systicks when current slot start
+static uint32_t meter_div;      // cycles per us
+
+void cupkee_meter_setup(void)
+{
+    uint32_t freq = hw_cycle_freq();
+
+    memset(meter_slots, 0, sizeof(meter_slots));
+    meter_curr = 0;
+    meter_full = 0;
+    meter_begin = _cupkee_systicks;
+    meter_div = freq / 1000000 ? freq / 1000000 : 1;
+}
+
+void cupkee_meter_add(int item, uint32_t begin, uint32_t end)
+{
+    if ((unsigned)item < CUPKEE_METER_ITEM_MAX) {
+        meter_slots[meter_curr].time[item] += end - begin;
+    }
+}
+
+void cupkee_meter_loop(uint32_t begin, uint32_t end, int worked)
+{
+    meter_slot_t *slot = &meter_slots[meter_curr];
+    uint32_t cycles = end - begin;
+    uint32_t ticks;
+
+    slot->loops++;
+    if (!worked) {
+        slot->idle++;
+    }
+    if (cycles > slot->loop_max) {
+        slot->loop_max = cycles;
+    }
+
+    ticks = _cupkee_systicks - meter_begin;
+    if (ticks >= METER_SLOT_TICKS) {
+        slot->ticks = ticks;
+
+        if (++meter_curr > CUPKEE_METER_SLOTS) {
+            meter_curr = 0;
+        }
+        if (meter_full < CUPKEE_METER_SLOTS) {
+            meter_full++;
+        }
+        memset(&meter_slots[meter_curr], 0, sizeof(meter_slot_t));
+        meter_begin += ticks;
+    }
+}
+
+int cupkee_meter_stats(cupkee_meter_stat_t *stat)
+{
+    uint64_t ticks = 0;
+    int i, n, pos;
+
+    memset(stat, 0, sizeof(*stat));
+
+    // Walk back from the last slot finished
+    for (n = 0, pos = meter_curr; n < meter_full; n++) {
+        meter_slot_t *slot;
+
+        pos = pos ? pos - 1 : CUPKEE_METER_SLOTS;
+        slot = &meter_slots[pos];
+
+        ticks += slot->ticks;
+        stat->loops += slot->loops;
+        stat->idle += slot->idle;
+        if (slot->loop_max > stat->loop_max) {
+            stat->loop_max = slot->loop_max;
+        }
+        for (i = 0; i < CUPKEE_METER_ITEM_MAX; i++) {
+            stat->time[i] += slot->time[i] / meter_div;
+        }
+    }
+
+    stat->window = ticks * 1000 / SYSTEM_TICKS_PRE_SEC;
+    stat->loop_max /= meter_div;
+    if (stat->window) {
+        stat->loops_per_sec = (uint64_t)stat->loops * 1000 / stat->window;
+    }
+
+    return CUPKEE_OK;
+}
+
+#endif
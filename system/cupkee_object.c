@@ -19,13 +19,20 @@
 
 #include "cupkee.h"
 
-#define CUPKEE_OBJECT_TAG_MAX   (16)
 #define CUPKEE_OBJECT_NUM_DEF   (32)
 
+/* Objects of a tag are the same size, reserved ones are kept in a pool:
+ * a single memory block of pool_num slots, free slots are linked by
+ * cupkee_object_t.list.next
+ */
 typedef struct cupkee_object_info_t {
     size_t size;
     const cupkee_desc_t *desc;
     void *meta;
+
+    uint8_t     *pool;
+    uint8_t     *pool_end;
+    list_head_t *pool_free;
 } cupkee_object_info_t;
 
 static list_head_t      obj_list_head;
@@ -75,6 +82,57 @@ static int object_id_alloc(void)
     return -1;
 }
 
+static inline size_t object_slot_size(size_t size)
+{
+    return CUPKEE_SIZE_ALIGN(sizeof(cupkee_object_t) + size, sizeof(intptr_t));
+}
+
+static int object_pool_init(cupkee_object_info_t *info, int num)
+{
+    size_t slot = object_slot_size(info->size);
+    int i;
+
+    info->pool = cupkee_malloc(slot * num);
+    if (!info->pool) {
+        return -CUPKEE_ENOMEM;
+    }
+    info->pool_end = info->pool + slot * num;
+    info->pool_free = NULL;
+
+    for (i = num - 1; i >= 0; i--) {
+        list_head_t *node = (list_head_t *)(info->pool + slot * i);
+
+        node->next = info->pool_free;
+        info->pool_free = node;
+    }
+
+    return CUPKEE_OK;
+}
+
+static inline cupkee_object_t *object_alloc(cupkee_object_info_t *info)
+{
+    list_head_t *node = info->pool_free;
+
+    if (node) {
+        info->pool_free = node->next;
+        return (cupkee_object_t *)node;
+    }
+
+    return (cupkee_object_t *)cupkee_malloc(sizeof(cupkee_object_t) + info->size);
+}
+
+static inline void object_release(cupkee_object_info_t *info, cupkee_object_t *obj)
+{
+    uint8_t *p = (uint8_t *)obj;
+
+    if (p >= info->pool && p < info->pool_end) {
+        obj->list.next = info->pool_free;
+        info->pool_free = &obj->list;
+    } else {
+        cupkee_free(obj);
+    }
+}
+
 static inline cupkee_object_t *object_get_by_id(int id) {
     if ((unsigned)id >= (unsigned)obj_map_size) {
         return NULL;
@@ -127,10 +185,11 @@ void cupkee_object_gc(void)
     }
 }
 
-void cupkee_object_event_dispatch(uint16_t id, uint8_t code)
+int cupkee_object_event_dispatch(uint16_t id, uint8_t code)
 {
     cupkee_object_t *obj = object_get_by_id(id);
     const cupkee_desc_t *desc = object_desc(obj);
+    int tag = desc ? obj->tag : -1;
 
     if (code == CUPKEE_EVENT_DESTROY) {
         cupkee_object_destroy(obj);
@@ -139,9 +198,11 @@ void cupkee_object_event_dispatch(uint16_t id, uint8_t code)
     if (desc && desc->event_handle) {
         desc->event_handle(obj->entry, code);
     }
+
+    return tag;
 }
 
-int cupkee_object_register(size_t size, const cupkee_desc_t *desc)
+int cupkee_object_register(size_t size, const cupkee_desc_t *desc, int reserve)
 {
     if (obj_tag_end >= CUPKEE_OBJECT_TAG_MAX) {
         return -1;
@@ -150,6 +211,10 @@ int cupkee_object_register(size_t size, const cupkee_desc_t *desc)
     obj_infos[obj_tag_end].size = size;
     obj_infos[obj_tag_end].desc = desc;
 
+    if (reserve > 0 && 0 != object_pool_init(&obj_infos[obj_tag_end], reserve)) {
+        return -1;
+    }
+
     return obj_tag_end++;
 }
 
@@ -184,7 +249,7 @@ cupkee_object_t *cupkee_object_create(int tag)
         cupkee_object_info_t *desc = &obj_infos[tag];
         cupkee_object_t *obj;
 
-        obj = (cupkee_object_t *)cupkee_malloc(sizeof(cupkee_object_t) + desc->size);
+        obj = object_alloc(desc);
         if (obj) {
             memset(obj->entry, 0, desc->size);
             obj->tag = tag;
@@ -228,7 +293,7 @@ void cupkee_object_destroy(cupkee_object_t *obj)
 
         list_del(&obj->list);
 
-        cupkee_free(obj);
+        object_release(&obj_infos[obj->tag], obj);
     }
 }
 
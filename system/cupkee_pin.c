@@ -80,7 +80,7 @@ static int pin_group_set_elem (void *entry, int i, int t, intptr_t v)
 {
     pin_group_t *g = entry;
 
-    if (g && t == CUPKEE_OBJECT_ELEM_INT && i >= 0 && i < g->max) {
+    if (g && t == CUPKEE_OBJECT_ELEM_INT && i >= 0 && i < g->num) {
         uint8_t pin = g->pin[i];
 
         if (pin_is_valid(pin)) {
@@ -94,7 +94,7 @@ static int pin_group_get_elem (void *entry, int i, intptr_t *p)
 {
     pin_group_t *g = entry;
 
-    if (g && i >= 0 && i < g->max) {
+    if (g && i >= 0 && i < g->num) {
         uint8_t pin = g->pin[i];
 
         if (pin_is_valid(pin)) {
@@ -177,7 +177,7 @@ int cupkee_pin_setup(void)
     pin_map = NULL;
     pin_event_handle_head = NULL;
 
-    tag = cupkee_object_register(sizeof(pin_group_t), &pin_group_desc);
+    tag = cupkee_object_register(sizeof(pin_group_t), &pin_group_desc, CUPKEE_PIN_GROUP_RESERVE);
     if (tag < 0) {
         return tag;
     }
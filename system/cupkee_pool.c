@@ -0,0 +1,129 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include "cupkee.h"
+
+#define POOL_INDEX_MASK     (0xFFFF)
+#define POOL_TAG_STEP       (0x10000)
+
+static inline uint16_t *pool_link(cupkee_pool_t *pool, unsigned i)
+{
+    return (uint16_t *)(pool->base + pool->block_size * i);
+}
+
+static inline int pool_cas(uint32_t *head, uint32_t *old, uint32_t new)
+{
+    return __atomic_compare_exchange_n(head, old, new, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+int cupkee_pool_init(cupkee_pool_t *pool, void *mem, size_t block_size, int block_num)
+{
+    int i;
+
+    block_size = CUPKEE_SIZE_ALIGN(block_size, sizeof(intptr_t));
+    if (!pool || !mem || !block_size || block_num <= 0 || block_num > CUPKEE_POOL_BLOCK_MAX ||
+        block_size > 0xFFFF) {
+        return -CUPKEE_EINVAL;
+    }
+
+    // Memory is sized by caller for block_num blocks, no room to align it
+    if ((intptr_t)mem & (sizeof(intptr_t) - 1)) {
+        return -CUPKEE_EINVAL;
+    }
+
+    pool->base = mem;
+    pool->block_size = block_size;
+    pool->block_num = block_num;
+
+    for (i = 0; i < block_num; i++) {
+        *pool_link(pool, i) = i + 2 <= block_num ? i + 2 : 0;
+    }
+    pool->free_num = block_num;
+
+    __atomic_store_n(&pool->head, 1, __ATOMIC_RELEASE);
+
+    return CUPKEE_OK;
+}
+
+cupkee_pool_t *cupkee_pool_create(size_t block_size, int block_num)
+{
+    cupkee_pool_t *pool;
+    size_t size;
+
+    if (block_num <= 0 || block_num > CUPKEE_POOL_BLOCK_MAX) {
+        return NULL;
+    }
+
+    size = CUPKEE_SIZE_ALIGN(block_size, sizeof(intptr_t)) * block_num;
+    pool = cupkee_malloc(sizeof(cupkee_pool_t) + size);
+    if (pool && 0 != cupkee_pool_init(pool, pool + 1, block_size, block_num)) {
+        cupkee_free(pool);
+        pool = NULL;
+    }
+
+    return pool;
+}
+
+void cupkee_pool_release(cupkee_pool_t *pool)
+{
+    cupkee_free(pool);
+}
+
+void *cupkee_pool_alloc(cupkee_pool_t *pool)
+{
+    uint32_t old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    uint32_t new;
+    unsigned i;
+
+    do {
+        i = old & POOL_INDEX_MASK;
+        if (!i) {
+            return NULL;
+        }
+
+        // Link may be overwritten by who took the block just now,
+        // the tag in head makes the swap fail in that case.
+        new = ((old + POOL_TAG_STEP) & ~POOL_INDEX_MASK) |
+              __atomic_load_n(pool_link(pool, i - 1), __ATOMIC_RELAXED);
+    } while (!pool_cas(&pool->head, &old, new));
+
+    __atomic_fetch_sub(&pool->free_num, 1, __ATOMIC_RELAXED);
+
+    return pool->base + pool->block_size * (i - 1);
+}
+
+void cupkee_pool_free(cupkee_pool_t *pool, void *block)
+{
+    uint32_t off = (uint8_t *)block - pool->base;
+    uint32_t old, new;
+    unsigned i;
+
+    if (off >= (uint32_t)pool->block_size * pool->block_num || off % pool->block_size) {
+        return;
+    }
+    i = off / pool->block_size;
+
+    old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    do {
+        __atomic_store_n(pool_link(pool, i), old & POOL_INDEX_MASK, __ATOMIC_RELAXED);
+        new = ((old + POOL_TAG_STEP) & ~POOL_INDEX_MASK) | (i + 1);
+    } while (!pool_cas(&pool->head, &old, new));
+
+    __atomic_fetch_add(&pool->free_num, 1, __ATOMIC_RELAXED);
+}
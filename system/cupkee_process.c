@@ -19,16 +19,151 @@
 
 #include <cupkee.h>
 
+#define PROCESS_FL_QUEUED   0x01
+#define PROCESS_FL_PARKED   0x02
+#define PROCESS_FL_DEADLINE 0x04    // parked with timeout
+#define PROCESS_FL_OBJECT   0x08    // parked for object event
+
 typedef struct cupkee_process_t {
+    struct cupkee_process_t *next;  // in run queue or parked list
+
     uint8_t step;
     uint8_t flags;
 
+    uint8_t  wait_event;
+    uint16_t wait_id;
+    uint32_t wait_from;
+    uint32_t wait_ticks;
+    int      woken;
+
     intptr_t data;
 
     void (*task) (void *entry);
     void (*finish) (int state, intptr_t data);
 } cupkee_process_t;
 
+/* Processes wait to run the next step, in order of request. Steps are run
+ * from main loop, so task never called in task of itself and stack depth
+ * keep the same, whatever number of steps.
+ */
+static cupkee_process_t *process_head = NULL;
+static cupkee_process_t *process_tail = NULL;
+
+/* Processes parked on condition, wait in place without polling */
+static cupkee_process_t *process_parked = NULL;
+
+static void process_enqueue(cupkee_process_t *_entry)
+{
+    if (_entry->flags & PROCESS_FL_QUEUED) {
+        return;
+    }
+
+    _entry->flags |= PROCESS_FL_QUEUED;
+    _entry->next = NULL;
+    if (process_tail) {
+        process_tail->next = _entry;
+    } else {
+        process_head = _entry;
+    }
+    process_tail = _entry;
+}
+
+static void process_dequeue(cupkee_process_t *_entry)
+{
+    cupkee_process_t *prev = NULL, *curr;
+
+    if (_entry->flags & PROCESS_FL_PARKED) {
+        curr = process_parked;
+    } else
+    if (_entry->flags & PROCESS_FL_QUEUED) {
+        curr = process_head;
+    } else {
+        return;
+    }
+
+    while (curr && curr != _entry) {
+        prev = curr;
+        curr = curr->next;
+    }
+
+    if (curr) {
+        if (prev) {
+            prev->next = curr->next;
+        } else
+        if (_entry->flags & PROCESS_FL_PARKED) {
+            process_parked = curr->next;
+        } else {
+            process_head = curr->next;
+        }
+        if (!(_entry->flags & PROCESS_FL_PARKED) && process_tail == curr) {
+            process_tail = prev;
+        }
+    }
+    _entry->flags &= ~(PROCESS_FL_QUEUED | PROCESS_FL_PARKED | PROCESS_FL_DEADLINE | PROCESS_FL_OBJECT);
+}
+
+static void process_park(cupkee_process_t *_entry)
+{
+    if (!(_entry->flags & PROCESS_FL_PARKED)) {
+        _entry->flags |= PROCESS_FL_PARKED;
+        _entry->next = process_parked;
+        process_parked = _entry;
+    }
+}
+
+/* Condition met, take the next step */
+static void process_wake(cupkee_process_t *_entry, int woken)
+{
+    process_dequeue(_entry);
+
+    _entry->woken = woken;
+    _entry->step++;
+    process_enqueue(_entry);
+}
+
+static void process_finish(cupkee_process_t *_entry, int state)
+{
+    process_dequeue(_entry);
+
+    if (_entry->finish) {
+        _entry->finish(state, _entry->data);
+    }
+
+    cupkee_free(_entry);
+}
+
+void cupkee_process_setup(void)
+{
+    process_head = NULL;
+    process_tail = NULL;
+    process_parked = NULL;
+}
+
+int cupkee_process_poll(int budget)
+{
+    int n = 0;
+
+    while (process_head && n < budget) {
+        cupkee_process_t *_entry = process_head;
+
+        process_head = _entry->next;
+        if (!process_head) {
+            process_tail = NULL;
+        }
+        _entry->flags &= ~PROCESS_FL_QUEUED;
+
+        _entry->task(_entry);
+        n++;
+    }
+
+    return n;
+}
+
+int cupkee_process_pending(void)
+{
+    return process_head != NULL;
+}
+
 int cupkee_process_start(void (*fn)(void *entry), intptr_t data, void (*finish)(int state, intptr_t data))
 {
     cupkee_process_t *_entry;
@@ -42,8 +177,10 @@ int cupkee_process_start(void (*fn)(void *entry), intptr_t data, void (*finish)(
         return -CUPKEE_ENOMEM;
     }
 
+    _entry->next = NULL;
     _entry->step = 0;
     _entry->flags = 0;
+    _entry->woken = 0;
 
     _entry->data = data;
     _entry->task = fn;
@@ -80,7 +217,7 @@ void cupkee_process_goto(void *entry, int step)
         cupkee_process_fail(_entry, -CUPKEE_EINVAL);
     } else {
         _entry->step = step;
-        _entry->task(entry);
+        process_enqueue(_entry);
     }
 }
 
@@ -93,7 +230,7 @@ void cupkee_process_next(void *entry)
     }
 
     _entry->step++;
-    _entry->task(entry);
+    process_enqueue(_entry);
 }
 
 void cupkee_process_done(void *entry)
@@ -104,11 +241,7 @@ void cupkee_process_done(void *entry)
         return;
     }
 
-    if (_entry->finish) {
-        _entry->finish(CUPKEE_OK, _entry->data);
-    }
-
-    cupkee_free(entry);
+    process_finish(_entry, CUPKEE_OK);
 }
 
 void cupkee_process_fail(void *entry, int err)
@@ -119,10 +252,117 @@ void cupkee_process_fail(void *entry, int err)
         return;
     }
 
-    if (_entry->finish) {
-        _entry->finish(err, _entry->data);
+    process_finish(_entry, err);
+}
+
+int cupkee_process_wait_timeout(void *entry, uint32_t ticks)
+{
+    cupkee_process_t *_entry = (cupkee_process_t *)entry;
+
+    if (!_entry || (_entry->flags & PROCESS_FL_QUEUED)) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (!ticks) {
+        process_wake(_entry, -CUPKEE_ETIMEOUT);
+    } else {
+        _entry->wait_from = _cupkee_systicks;
+        _entry->wait_ticks = ticks;
+        _entry->flags |= PROCESS_FL_DEADLINE;
+        process_park(_entry);
+    }
+
+    return CUPKEE_OK;
+}
+
+int cupkee_process_wait_object(void *entry, int id, int event)
+{
+    cupkee_process_t *_entry = (cupkee_process_t *)entry;
+
+    if (!_entry || (_entry->flags & PROCESS_FL_QUEUED) || id < 0) {
+        return -CUPKEE_EINVAL;
+    }
+
+    _entry->wait_id = id;
+    _entry->wait_event = event;
+    _entry->flags |= PROCESS_FL_OBJECT;
+    process_park(_entry);
+
+    return CUPKEE_OK;
+}
+
+int cupkee_process_wait_response(void *entry, void *device)
+{
+    cupkee_process_t *_entry = (cupkee_process_t *)entry;
+    int busy = cupkee_device_is_busy(device);
+
+    if (!_entry || busy < 0) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (!busy) {
+        // Response dispatched already
+        process_wake(_entry, CUPKEE_EVENT_RESPONSE);
+        return CUPKEE_OK;
+    }
+
+    return cupkee_process_wait_object(entry, CUPKEE_ENTRY_ID(device), CUPKEE_EVENT_RESPONSE);
+}
+
+int cupkee_process_woken(void *entry)
+{
+    cupkee_process_t *_entry = (cupkee_process_t *)entry;
+
+    return _entry ? _entry->woken : -CUPKEE_EINVAL;
+}
+
+void cupkee_process_sync(uint32_t systicks)
+{
+    cupkee_process_t *curr = process_parked;
+
+    while (curr) {
+        cupkee_process_t *next = curr->next;
+
+        if ((curr->flags & PROCESS_FL_DEADLINE) && systicks - curr->wait_from >= curr->wait_ticks) {
+            process_wake(curr, -CUPKEE_ETIMEOUT);
+        }
+        curr = next;
+    }
+}
+
+void cupkee_process_event(uint16_t id, uint8_t code)
+{
+    cupkee_process_t *curr = process_parked;
+
+    while (curr) {
+        cupkee_process_t *next = curr->next;
+
+        if ((curr->flags & PROCESS_FL_OBJECT) && curr->wait_id == id && curr->wait_event == code) {
+            process_wake(curr, code);
+        }
+        curr = next;
+    }
+}
+
+uint32_t cupkee_process_deadline(uint32_t systicks)
+{
+    cupkee_process_t *curr = process_parked;
+    uint32_t next = CUPKEE_TICKS_FOREVER;
+
+    while (curr) {
+        if (curr->flags & PROCESS_FL_DEADLINE) {
+            uint32_t passed = systicks - curr->wait_from;
+
+            if (passed >= curr->wait_ticks) {
+                return 0;
+            }
+            if (curr->wait_ticks - passed < next) {
+                next = curr->wait_ticks - passed;
+            }
+        }
+        curr = curr->next;
     }
 
-    cupkee_free(entry);
+    return next;
 }
 
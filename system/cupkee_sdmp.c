@@ -50,6 +50,13 @@ enum sdmp_response_code_e {
     SDMP_ExecuteError,
 };
 
+enum sdmp_sysstat_e {
+    SDMP_SYSSTAT_MEMORY = 0,
+    SDMP_SYSSTAT_MEMTRACE,
+    SDMP_SYSSTAT_EVENT,
+    SDMP_SYSSTAT_LOOP,
+};
+
 enum sdmp_message_code_e {
     SDMP_REQ_HELLO = 0x00,
     SDMP_REQ_EXECUTE_FUNC,
@@ -63,6 +70,7 @@ enum sdmp_message_code_e {
     SDMP_REQ_QUERY_APPSTATE,
     SDMP_REQ_QUERY_APPDATA,
     SDMP_REQ_WRITE_APPDATA,
+    SDMP_REQ_QUERY_SYSSTAT,
 
     SDMP_RESPONSE = 0x80,
     SDMP_REPORT   = 0x81,
@@ -88,6 +96,8 @@ static cupkee_buffer_t sdmp_mux_text_buf;
 
 static uint16_t sdmp_script_buf_size = 0;
 static char *   sdmp_script_buf = NULL;
+// Script buffer lives from the first to the last piece of script only
+static cupkee_arena_t sdmp_script_arena;
 
 static void (*sdmp_text_handler)(int, const void *) = NULL;
 static int (*sdmp_user_call_handler)(int, void *) = NULL;
@@ -194,11 +204,9 @@ static void sdmp_response_status(uint8_t req, uint8_t err)
 
 static inline void sdmp_script_buf_free(void)
 {
-    if (sdmp_script_buf) {
-        cupkee_free(sdmp_script_buf);
-        sdmp_script_buf = NULL;
-    }
+    cupkee_arena_release(&sdmp_script_arena);
 
+    sdmp_script_buf = NULL;
     sdmp_script_buf_size = 0;
 }
 
@@ -411,9 +419,9 @@ static void sdmp_execute_script(uint16_t req_len, uint8_t *req)
 
     if (cur == 0) {
         int total = end * 252;
-        sdmp_script_buf_free();
 
-        sdmp_script_buf = cupkee_malloc(total);
+        sdmp_script_buf_free();
+        sdmp_script_buf = cupkee_arena_alloc(&sdmp_script_arena, total);
         if (!sdmp_script_buf) {
             error = SDMP_MemNotEnought;
             goto DO_ERROR;
@@ -442,6 +450,7 @@ static void sdmp_execute_script(uint16_t req_len, uint8_t *req)
         } else {
             sdmp_response_status(req[0], SDMP_OK);
         }
+        sdmp_script_buf_free();
     } else {
         sdmp_response_cont(req[0], next);
     }
@@ -502,6 +511,224 @@ static void sdmp_write_appdata(uint16_t req_len, uint8_t *req)
     sdmp_response_status(req[0], SDMP_NotImplemented);
 }
 
+static uint8_t *sdmp_put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) (v);
+
+    return p + 4;
+}
+
+static uint8_t *sdmp_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) (v >> 8);
+    p[1] = (uint8_t) (v);
+
+    return p + 2;
+}
+
+static void sdmp_query_sysstat_memory(void)
+{
+    cupkee_memory_stat_t stat;
+    sdmp_message_t msg;
+    uint8_t *p;
+    int len, i;
+
+    // u32 x 7, u8 fragment, u32 free pages of each order, u16 size & u32 pages, blocks of each queue
+    len = 4 * 7 + 1 + 4 * CUPKEE_PAGE_ORDERR_MAX + 10 * CUPKEE_MBCQ_MAX;
+    if ((len = sdmp_message_init(&msg, SDMP_RESPONSE, 3, len)) <= 0) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_MemNotEnought);
+        return;
+    }
+
+    cupkee_memory_stats(&stat);
+
+    msg.param[0] = SDMP_REQ_QUERY_SYSSTAT;
+    msg.param[1] = SDMP_OK;
+    msg.param[2] = SDMP_SYSSTAT_MEMORY;
+
+    p = msg.data;
+    p = sdmp_put_u32(p, stat.bytes_used);
+    p = sdmp_put_u32(p, stat.bytes_peak);
+    p = sdmp_put_u32(p, stat.alloc_fails);
+    p = sdmp_put_u32(p, stat.free_bytes);
+    p = sdmp_put_u32(p, stat.largest_free);
+    p = sdmp_put_u32(p, stat.cache_kept);
+    p = sdmp_put_u32(p, stat.cache_reused);
+    *p++ = stat.fragment;
+    for (i = 0; i < CUPKEE_PAGE_ORDERR_MAX; i++) {
+        p = sdmp_put_u32(p, stat.free_pages[i]);
+    }
+    for (i = 0; i < CUPKEE_MBCQ_MAX; i++) {
+        p = sdmp_put_u16(p, stat.mbcq_size[i]);
+        p = sdmp_put_u32(p, stat.mbcq_pages[i]);
+        p = sdmp_put_u32(p, stat.mbcq_blocks[i]);
+    }
+
+    sdmp_message_send(len);
+}
+
+#define SDMP_TRACE_REC_SIZE     (18)
+#define SDMP_TRACE_REC_MAX      (12)
+
+/* Response: lost u32 and count u8 in param, then count records of
+ * tick u32, op u8, order u8, size u32, ptr u32, prev u32.
+ * Host should query again, until count is 0.
+ */
+static void sdmp_query_sysstat_memtrace(void)
+{
+    cupkee_memory_trace_t rec[SDMP_TRACE_REC_MAX];
+    sdmp_message_t msg;
+    uint8_t *p;
+    int len, i, n;
+
+    len = SDMP_TRACE_REC_SIZE * SDMP_TRACE_REC_MAX;
+    if ((len = sdmp_message_init(&msg, SDMP_RESPONSE, 8, len)) <= 0) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_MemNotEnought);
+        return;
+    }
+
+    n = cupkee_memory_trace_read(rec, SDMP_TRACE_REC_MAX);
+
+    msg.param[0] = SDMP_REQ_QUERY_SYSSTAT;
+    msg.param[1] = SDMP_OK;
+    msg.param[2] = SDMP_SYSSTAT_MEMTRACE;
+    sdmp_put_u32(msg.param + 3, cupkee_memory_trace_lost());
+    msg.param[7] = n;
+
+    p = msg.data;
+    for (i = 0; i < n; i++) {
+        p = sdmp_put_u32(p, rec[i].tick);
+        *p++ = rec[i].op;
+        *p++ = rec[i].order;
+        p = sdmp_put_u32(p, rec[i].size);
+        p = sdmp_put_u32(p, rec[i].ptr);
+        p = sdmp_put_u32(p, rec[i].prev);
+    }
+    // Unused records are zero
+    memset(p, 0, SDMP_TRACE_REC_SIZE * (SDMP_TRACE_REC_MAX - n));
+
+    sdmp_message_send(len);
+}
+
+/* Request: type u8 of event
+ * Response: type u8 and traced u8 in param, then queue depth, peak, high depth,
+ * high peak u16, coalesced u32, and of the type: dropped u32, delay count, min,
+ * avg, max u32 in us, histogram u16 x CUPKEE_EVENT_TRACE_HIST. Delay is zero if
+ * event trace disabled.
+ */
+static void sdmp_query_sysstat_event(uint8_t type)
+{
+    cupkee_event_stat_t stat;
+    cupkee_event_delay_t delay;
+    sdmp_message_t msg;
+    uint8_t *p;
+    int len, i, traced;
+
+    if (type >= EVENT_TYPE_MAX) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_InvalidParam);
+        return;
+    }
+
+    len = 2 * 4 + 4 * 6 + 2 * CUPKEE_EVENT_TRACE_HIST;
+    if ((len = sdmp_message_init(&msg, SDMP_RESPONSE, 5, len)) <= 0) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_MemNotEnought);
+        return;
+    }
+
+    cupkee_event_stats(&stat);
+    traced = 0 == cupkee_event_delay_get(type, &delay);
+    if (!traced) {
+        memset(&delay, 0, sizeof(delay));
+    }
+
+    msg.param[0] = SDMP_REQ_QUERY_SYSSTAT;
+    msg.param[1] = SDMP_OK;
+    msg.param[2] = SDMP_SYSSTAT_EVENT;
+    msg.param[3] = type;
+    msg.param[4] = traced;
+
+    p = msg.data;
+    p = sdmp_put_u16(p, stat.depth);
+    p = sdmp_put_u16(p, stat.peak);
+    p = sdmp_put_u16(p, stat.high_depth);
+    p = sdmp_put_u16(p, stat.high_peak);
+    p = sdmp_put_u32(p, stat.coalesced);
+    p = sdmp_put_u32(p, stat.dropped[type]);
+    p = sdmp_put_u32(p, delay.count);
+    p = sdmp_put_u32(p, delay.min);
+    p = sdmp_put_u32(p, delay.avg);
+    p = sdmp_put_u32(p, delay.max);
+    for (i = 0; i < CUPKEE_EVENT_TRACE_HIST; i++) {
+        p = sdmp_put_u16(p, delay.hist[i] > 0xFFFF ? 0xFFFF : delay.hist[i]);
+    }
+
+    sdmp_message_send(len);
+}
+
+/* Response: window ms, loops, loops per second, idle loops, longest loop us,
+ * then us spent in device polling, event dispatch, systick, pin and object
+ * of each tag, all u32.
+ */
+static void sdmp_query_sysstat_loop(void)
+{
+    cupkee_meter_stat_t stat;
+    sdmp_message_t msg;
+    uint8_t *p;
+    int len, i;
+
+    if (0 != cupkee_meter_stats(&stat)) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_NotImplemented);
+        return;
+    }
+
+    len = 4 * (5 + CUPKEE_METER_ITEM_MAX);
+    if ((len = sdmp_message_init(&msg, SDMP_RESPONSE, 3, len)) <= 0) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_MemNotEnought);
+        return;
+    }
+
+    msg.param[0] = SDMP_REQ_QUERY_SYSSTAT;
+    msg.param[1] = SDMP_OK;
+    msg.param[2] = SDMP_SYSSTAT_LOOP;
+
+    p = msg.data;
+    p = sdmp_put_u32(p, stat.window);
+    p = sdmp_put_u32(p, stat.loops);
+    p = sdmp_put_u32(p, stat.loops_per_sec);
+    p = sdmp_put_u32(p, stat.idle);
+    p = sdmp_put_u32(p, stat.loop_max);
+    for (i = 0; i < CUPKEE_METER_ITEM_MAX; i++) {
+        p = sdmp_put_u32(p, stat.time[i]);
+    }
+
+    sdmp_message_send(len);
+}
+
+static void sdmp_query_sysstat(uint16_t req_len, uint8_t *req)
+{
+    if (req_len < 2) {
+        sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_InvalidParam);
+        return;
+    }
+
+    switch (req[1]) {
+    case SDMP_SYSSTAT_MEMORY:   sdmp_query_sysstat_memory(); break;
+    case SDMP_SYSSTAT_MEMTRACE: sdmp_query_sysstat_memtrace(); break;
+    case SDMP_SYSSTAT_EVENT:
+        if (req_len < 3) {
+            sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_InvalidParam);
+        } else {
+            sdmp_query_sysstat_event(req[2]);
+        }
+        break;
+    case SDMP_SYSSTAT_LOOP:     sdmp_query_sysstat_loop(); break;
+    default: sdmp_response_status(SDMP_REQ_QUERY_SYSSTAT, SDMP_InvalidParam);
+    }
+}
+
 static void sdmp_request_handler(uint16_t len, uint8_t *req)
 {
     uint8_t code = req[0];
@@ -521,6 +748,7 @@ static void sdmp_request_handler(uint16_t len, uint8_t *req)
     case SDMP_REQ_QUERY_APPSTATE:   sdmp_query_appstate(len, req); break;
     case SDMP_REQ_QUERY_APPDATA:    sdmp_query_appdata(len, req); break;
     case SDMP_REQ_WRITE_APPDATA:    sdmp_write_appdata(len, req); break;
+    case SDMP_REQ_QUERY_SYSSTAT:    sdmp_query_sysstat(len, req); break;
     default: sdmp_response_status(code, SDMP_InvalidReq);
     }
 }
@@ -598,6 +826,7 @@ int cupkee_sdmp_init(void *stream)
 
     sdmp_script_buf_size = 0;
     sdmp_script_buf = NULL;
+    cupkee_arena_init(&sdmp_script_arena);
 
     memset(sdmp_app_interface, 0, CUPKEE_UID_SIZE);
 
@@ -231,6 +231,126 @@ val_t native_sysinfos(env_t *env, int ac, val_t *av)
     return val_mk_undefined();
 }
 
+val_t native_meminfo(env_t *env, int ac, val_t *av)
+{
+    cupkee_memory_stat_t stat;
+    int i;
+
+    (void) env;
+    (void) ac;
+    (void) av;
+
+    cupkee_memory_stats(&stat);
+
+    console_log_sync("Used: %u, Peak: %u, Fails: %u\r\n",
+                     stat.bytes_used, stat.bytes_peak, stat.alloc_fails);
+    console_log_sync("Free: %u, Largest: %u, Fragment: %u%%\r\n",
+                     stat.free_bytes, stat.largest_free, stat.fragment);
+
+    console_log_sync("=============================\r\n");
+    for (i = 0; i < CUPKEE_PAGE_ORDERR_MAX; i++) {
+        console_log_sync("%dK: %u, ", 1 << i, stat.free_pages[i]);
+    }
+    console_log_sync("\r\n");
+
+    for (i = 0; i < CUPKEE_MBCQ_MAX; i++) {
+        if (stat.mbcq_pages[i]) {
+            console_log_sync("%u: %u/%u, ", stat.mbcq_size[i], stat.mbcq_blocks[i], stat.mbcq_pages[i]);
+        }
+    }
+    console_log_sync("\r\n");
+
+    return val_mk_undefined();
+}
+
+/* Dump memory trace, one record per line: tick op size order ptr prev */
+val_t native_memtrace(env_t *env, int ac, val_t *av)
+{
+    cupkee_memory_trace_t rec[8];
+    int i, n;
+
+    (void) env;
+    (void) ac;
+    (void) av;
+
+    console_log_sync("# lost: %u\r\n", (unsigned)cupkee_memory_trace_lost());
+    while (0 < (n = cupkee_memory_trace_read(rec, 8))) {
+        for (i = 0; i < n; i++) {
+            console_log_sync("%u %u %u %u %lx %lx\r\n",
+                             (unsigned)rec[i].tick, rec[i].op, (unsigned)rec[i].size, rec[i].order,
+                             (unsigned long)rec[i].ptr, (unsigned long)rec[i].prev);
+        }
+    }
+
+    return val_mk_undefined();
+}
+
+/* Event queue state, and queueing delay of each type if trace enabled */
+val_t native_eventinfo(env_t *env, int ac, val_t *av)
+{
+    static const char *type_name[EVENT_TYPE_MAX] = {"systick", "object", "pin"};
+    cupkee_event_stat_t stat;
+    cupkee_event_delay_t delay;
+    int type, i;
+
+    (void) env;
+    (void) ac;
+    (void) av;
+
+    cupkee_event_stats(&stat);
+
+    console_log_sync("Queue: %u/%u, High: %u/%u, Coalesced: %u\r\n",
+                     stat.peak, stat.depth, stat.high_peak, stat.high_depth,
+                     (unsigned)stat.coalesced);
+
+    for (type = 0; type < EVENT_TYPE_MAX; type++) {
+        console_log_sync("%s dropped: %u", type_name[type], (unsigned)stat.dropped[type]);
+
+        if (0 == cupkee_event_delay_get(type, &delay)) {
+            console_log_sync(", count: %u, delay(us) min: %u, avg: %u, max: %u\r\n",
+                             (unsigned)delay.count, (unsigned)delay.min,
+                             (unsigned)delay.avg, (unsigned)delay.max);
+            for (i = 0; i < CUPKEE_EVENT_TRACE_HIST; i++) {
+                console_log_sync("%u ", (unsigned)delay.hist[i]);
+            }
+        }
+        console_log_sync("\r\n");
+    }
+
+    return val_mk_undefined();
+}
+
+/* Main loop load over the meter window, time in us */
+val_t native_loopinfo(env_t *env, int ac, val_t *av)
+{
+    cupkee_meter_stat_t stat;
+    int tag;
+
+    (void) env;
+    (void) ac;
+    (void) av;
+
+    if (0 != cupkee_meter_stats(&stat)) {
+        console_log_sync("meter disabled\r\n");
+        return val_mk_undefined();
+    }
+
+    console_log_sync("Window: %ums, Loops: %u/s, Idle: %u/%u, Longest: %uus\r\n",
+                     (unsigned)stat.window, (unsigned)stat.loops_per_sec,
+                     (unsigned)stat.idle, (unsigned)stat.loops, (unsigned)stat.loop_max);
+    console_log_sync("Device: %u, Event: %u, Systick: %u, Pin: %u, Process: %u\r\n",
+                     (unsigned)stat.time[CUPKEE_METER_DEVICE], (unsigned)stat.time[CUPKEE_METER_EVENT],
+                     (unsigned)stat.time[CUPKEE_METER_SYSTICK], (unsigned)stat.time[CUPKEE_METER_PIN],
+                     (unsigned)stat.time[CUPKEE_METER_PROCESS]);
+    for (tag = 0; tag < CUPKEE_OBJECT_TAG_MAX; tag++) {
+        if (stat.time[CUPKEE_METER_OBJECT + tag]) {
+            console_log_sync("Object[%d]: %u\r\n", tag, (unsigned)stat.time[CUPKEE_METER_OBJECT + tag]);
+        }
+    }
+
+    return val_mk_undefined();
+}
+
 val_t native_systicks(env_t *env, int ac, val_t *av)
 {
     (void) env;
@@ -19,6 +19,8 @@
 
 #include <cupkee.h>
 
+#define STREAM_DATA_WAIT    (20)    // ticks, notify data left in rx buffer after
+
 static inline int stream_is_readable(cupkee_stream_t *s) {
     return s && (s->flags & CUPKEE_STREAM_FL_READABLE);
 }
@@ -35,6 +37,47 @@ static inline int stream_tx_request(cupkee_stream_t *s) {
     return s->_write(s, 0, NULL);
 }
 
+static inline size_t stream_rx_length(cupkee_stream_t *s) {
+    return cupkee_buffer_length(&s->rx_buf) + cupkee_block_queue_bytes(&s->rx_blocks);
+}
+
+static inline int stream_tx_is_empty(cupkee_stream_t *s) {
+    return cupkee_buffer_is_empty(&s->tx_buf) && cupkee_block_queue_is_empty(&s->tx_blocks);
+}
+
+/* Bytes cached in ring, as a block. Main loop only */
+static void *stream_ring_block(cupkee_buffer_t *ring)
+{
+    void *b = cupkee_block_alloc(cupkee_buffer_length(ring));
+
+    if (b) {
+        cupkee_block_set_length(b, cupkee_buffer_take(ring, cupkee_block_capacity(b), cupkee_block_ptr(b)));
+    }
+    return b;
+}
+
+/* Heap blocks drained by driver, released in main loop */
+static inline void stream_tx_collect(cupkee_stream_t *s) {
+    if (!cupkee_block_queue_is_empty(&s->tx_done)) {
+        cupkee_block_queue_clear(&s->tx_done);
+    }
+}
+
+static void stream_rx_notify(cupkee_stream_t *s)
+{
+    if (s->flags & CUPKEE_STREAM_FL_NOTIFY_DATA && stream_rx_length(s) > s->rx_buf_size / 2) {
+        cupkee_object_event_post(s->id, CUPKEE_EVENT_DATA);
+    }
+    s->last_push = _cupkee_systicks;
+}
+
+static void stream_tx_notify(cupkee_stream_t *s)
+{
+    if (stream_tx_is_empty(s) && s->flags & CUPKEE_STREAM_FL_NOTIFY_DRAIN) {
+        cupkee_object_event_post(s->id, CUPKEE_EVENT_DRAIN);
+    }
+}
+
 int cupkee_stream_init(
    cupkee_stream_t *s, int id,
    size_t rx_buf_size, size_t tx_buf_size,
@@ -49,6 +92,9 @@ int cupkee_stream_init(
     }
 
     memset(s, 0, sizeof(cupkee_stream_t));
+    cupkee_block_queue_init(&s->rx_blocks);
+    cupkee_block_queue_init(&s->tx_blocks);
+    cupkee_block_queue_init(&s->tx_done);
     if (rx_buf_size && _read) {
         s->_read = _read;
         s->rx_buf_size = rx_buf_size;
@@ -76,10 +122,86 @@ int cupkee_stream_deinit(cupkee_stream_t *s)
 
         cupkee_buffer_deinit(&s->rx_buf);
         cupkee_buffer_deinit(&s->tx_buf);
+        cupkee_block_queue_clear(&s->rx_blocks);
+        cupkee_block_queue_clear(&s->tx_blocks);
+        cupkee_block_queue_clear(&s->tx_done);
     }
     return 0;
 }
 
+static int stream_buffer_prepare(cupkee_buffer_t *new, uint16_t size, size_t want)
+{
+    if (want <= size) {
+        cupkee_buffer_reset(new);
+        return 0;
+    }
+    if (want > 0xFFFF) {
+        return -CUPKEE_EINVAL;
+    }
+    return cupkee_buffer_alloc(new, want) ? 1 : -CUPKEE_ENOMEM;
+}
+
+/* Both rings are grown, or neither */
+int cupkee_stream_resize(cupkee_stream_t *s, size_t rx_buf_size, size_t tx_buf_size)
+{
+    cupkee_buffer_t rx, tx;
+    int grow_rx, grow_tx;
+    uint32_t state;
+
+    if (!s) {
+        return -CUPKEE_EINVAL;
+    }
+
+    if (!stream_is_readable(s)) {
+        rx_buf_size = 0;
+    }
+    if (!stream_is_writable(s)) {
+        tx_buf_size = 0;
+    }
+
+    grow_rx = stream_buffer_prepare(&rx, s->rx_buf_size, rx_buf_size);
+    if (grow_rx < 0) {
+        return grow_rx;
+    }
+    grow_tx = stream_buffer_prepare(&tx, s->tx_buf_size, tx_buf_size);
+    if (grow_tx < 0) {
+        cupkee_buffer_deinit(&rx);
+        return grow_tx;
+    }
+
+    // Driver may push or pull in interrupt
+    hw_enter_critical(&state);
+    if ((grow_rx && !cupkee_buffer_is_empty(&s->rx_buf)) ||
+        (grow_tx && !cupkee_buffer_is_empty(&s->tx_buf))) {
+        hw_exit_critical(state);
+
+        cupkee_buffer_deinit(&rx);
+        cupkee_buffer_deinit(&tx);
+        return -CUPKEE_EBUSY;
+    }
+    if (grow_rx) {
+        cupkee_buffer_t old = s->rx_buf;
+
+        s->rx_buf = rx;
+        s->rx_buf_size = rx_buf_size;
+        rx = old;
+    }
+    if (grow_tx) {
+        cupkee_buffer_t old = s->tx_buf;
+
+        s->tx_buf = tx;
+        s->tx_buf_size = tx_buf_size;
+        tx = old;
+    }
+    hw_exit_critical(state);
+
+    // Old buffers
+    cupkee_buffer_deinit(&rx);
+    cupkee_buffer_deinit(&tx);
+
+    return CUPKEE_OK;
+}
+
 void cupkee_stream_listen(cupkee_stream_t *s, int event)
 {
     if (s) {
@@ -106,7 +228,7 @@ void cupkee_stream_ignore(cupkee_stream_t *s, int event)
 
 int cupkee_stream_readable(cupkee_stream_t *s)
 {
-    return stream_is_readable(s) ? cupkee_buffer_length(&s->rx_buf) : 0;
+    return stream_is_readable(s) ? stream_rx_length(s) : 0;
 }
 
 int cupkee_stream_writable(cupkee_stream_t *s)
@@ -120,13 +242,15 @@ int cupkee_stream_push(cupkee_stream_t *s, size_t n, const void *data)
     if (!stream_is_readable(s) || !n || !data) {
         return 0;
     } else {
-        cupkee_buffer_t *buf = &s->rx_buf;
-        int cnt = cupkee_buffer_give(buf, n, data);
+        int cnt;
 
-        if (s->flags & CUPKEE_STREAM_FL_NOTIFY_DATA && cupkee_buffer_length(buf) > s->rx_buf_size / 2) {
-            cupkee_object_event_post(s->id, CUPKEE_EVENT_DATA);
+        // Bytes come after blocks queued, should be queued behind them
+        if (cupkee_block_queue_is_empty(&s->rx_blocks)) {
+            cnt = cupkee_buffer_give(&s->rx_buf, n, data);
+        } else {
+            cnt = cupkee_block_queue_give(&s->rx_blocks, n, data);
         }
-        s->last_push = _cupkee_systicks;
+        stream_rx_notify(s);
 
         return cnt;
     }
@@ -134,20 +258,36 @@ int cupkee_stream_push(cupkee_stream_t *s, size_t n, const void *data)
 
 void cupkee_stream_sync(cupkee_stream_t *s, uint32_t systicks)
 {
+    stream_tx_collect(s);
+
     if (s->flags & CUPKEE_STREAM_FL_NOTIFY_DATA
-        && !cupkee_buffer_is_empty(&s->rx_buf)
-        && (systicks - s->last_push) > 20) {
+        && stream_rx_length(s)
+        && (systicks - s->last_push) > STREAM_DATA_WAIT) {
         cupkee_object_event_post(s->id, CUPKEE_EVENT_DATA);
     }
 }
 
+uint32_t cupkee_stream_next(cupkee_stream_t *s, uint32_t systicks)
+{
+    uint32_t passed = systicks - s->last_push;
+
+    if (!(s->flags & CUPKEE_STREAM_FL_NOTIFY_DATA) || !stream_rx_length(s)) {
+        return CUPKEE_TICKS_FOREVER;
+    }
+
+    return passed > STREAM_DATA_WAIT ? 0 : STREAM_DATA_WAIT + 1 - passed;
+}
+
 int cupkee_stream_pull(cupkee_stream_t *s, size_t n, void *data)
 {
     if (stream_is_writable(s) && n && data) {
         int cnt = cupkee_buffer_take(&s->tx_buf, n, data);
 
-        if (cnt > 0 && cupkee_buffer_is_empty(&s->tx_buf) && s->flags & CUPKEE_STREAM_FL_NOTIFY_DRAIN) {
-            cupkee_object_event_post(s->id, CUPKEE_EVENT_DRAIN);
+        if ((size_t)cnt < n && !cupkee_block_queue_is_empty(&s->tx_blocks)) {
+            cnt += cupkee_block_queue_take(&s->tx_blocks, n - cnt, (uint8_t *)data + cnt, &s->tx_done);
+        }
+        if (cnt > 0) {
+            stream_tx_notify(s);
         }
 
         return cnt;
@@ -182,6 +322,7 @@ void cupkee_stream_resume(cupkee_stream_t *s)
 int cupkee_stream_read(cupkee_stream_t *s, size_t n, void *buf)
 {
     size_t max;
+    int cnt;
 
     if (!stream_is_readable(s) || !buf) {
         return -CUPKEE_EINVAL;
@@ -191,11 +332,16 @@ int cupkee_stream_read(cupkee_stream_t *s, size_t n, void *buf)
         s->rx_state = CUPKEE_STREAM_STATE_PAUSED;
     }
 
-    if ((max = cupkee_buffer_length(&s->rx_buf)) < n) {
+    if ((max = stream_rx_length(s)) < n) {
         stream_rx_request(s, n - max);
     }
 
-    return cupkee_buffer_take(&s->rx_buf, n, buf);
+    cnt = cupkee_buffer_take(&s->rx_buf, n, buf);
+    if ((size_t)cnt < n && !cupkee_block_queue_is_empty(&s->rx_blocks)) {
+        cnt += cupkee_block_queue_take(&s->rx_blocks, n - cnt, (uint8_t *)buf + cnt, NULL);
+    }
+
+    return cnt;
 }
 
 int cupkee_stream_write(cupkee_stream_t *s, size_t n, const void *data)
@@ -205,6 +351,20 @@ int cupkee_stream_write(cupkee_stream_t *s, size_t n, const void *data)
     if (!stream_is_writable(s) || !data) {
         return -CUPKEE_EINVAL;
     }
+    stream_tx_collect(s);
+
+    if (!cupkee_block_queue_is_empty(&s->tx_blocks)) {
+        retv = cupkee_block_queue_give(&s->tx_blocks, n, data);
+        if ((size_t)retv < n) {
+            void *b = cupkee_block_create(n - retv, (const uint8_t *)data + retv);
+
+            if (b) {
+                cupkee_block_queue_push(&s->tx_blocks, b);
+                retv = n;
+            }
+        }
+        return retv;
+    }
 
     retv = cupkee_buffer_give(&s->tx_buf, n, data);
     if (retv == (int) cupkee_buffer_length(&s->tx_buf)) {
@@ -232,3 +392,105 @@ int cupkee_stream_write_sync(cupkee_stream_t *s, size_t n, const void *data)
     return s->_write(s, n, data);
 }
 
+int cupkee_stream_push_buf(cupkee_stream_t *s, void *data)
+{
+    if (!stream_is_readable(s) || !data) {
+        return -CUPKEE_EINVAL;
+    }
+
+    cupkee_block_queue_push(&s->rx_blocks, data);
+    stream_rx_notify(s);
+
+    return CUPKEE_OK;
+}
+
+void *cupkee_stream_pull_buf(cupkee_stream_t *s)
+{
+    void *b;
+
+    // Bytes in ring are taken by pull, write_buf never queue block behind them
+    if (!stream_is_writable(s) || !cupkee_buffer_is_empty(&s->tx_buf)) {
+        return NULL;
+    }
+
+    b = cupkee_block_queue_pop(&s->tx_blocks);
+    if (b) {
+        stream_tx_notify(s);
+    }
+    return b;
+}
+
+void cupkee_stream_free_buf(cupkee_stream_t *s, void *data)
+{
+    if (!data) {
+        return;
+    }
+
+    if (s && !cupkee_block_is_pooled(data)) {
+        cupkee_block_queue_push(&s->tx_done, data);
+    } else {
+        cupkee_block_release(data);
+    }
+}
+
+void *cupkee_stream_read_buf(cupkee_stream_t *s)
+{
+    if (!stream_is_readable(s)) {
+        return NULL;
+    }
+
+    if (s->rx_state == CUPKEE_STREAM_STATE_IDLE) {
+        s->rx_state = CUPKEE_STREAM_STATE_PAUSED;
+    }
+
+    if (!cupkee_buffer_is_empty(&s->rx_buf)) {
+        return stream_ring_block(&s->rx_buf);
+    } else {
+        void *b = cupkee_block_queue_pop(&s->rx_blocks);
+
+        if (!b) {
+            stream_rx_request(s, s->rx_buf_size);
+        }
+        return b;
+    }
+}
+
+int cupkee_stream_write_buf(cupkee_stream_t *s, void *data)
+{
+    int idle;
+
+    if (!stream_is_writable(s) || !data) {
+        return -CUPKEE_EINVAL;
+    }
+
+    stream_tx_collect(s);
+
+    // Bytes in ring go first, as a block: driver pull_buf never allocate
+    if (!cupkee_buffer_is_empty(&s->tx_buf) && cupkee_block_queue_is_empty(&s->tx_blocks)) {
+        void *b = cupkee_block_alloc(cupkee_buffer_length(&s->tx_buf));
+        uint32_t state;
+
+        if (!b) {
+            return -CUPKEE_ENOMEM;
+        }
+
+        hw_enter_critical(&state);
+        cupkee_block_set_length(b, cupkee_buffer_take(&s->tx_buf, cupkee_block_capacity(b), cupkee_block_ptr(b)));
+        if (cupkee_block_length(b)) {
+            cupkee_block_queue_push(&s->tx_blocks, b);
+            b = NULL;
+        }
+        hw_exit_critical(state);
+
+        cupkee_block_release(b);
+    }
+
+    idle = stream_tx_is_empty(s);
+    cupkee_block_queue_push(&s->tx_blocks, data);
+    if (idle) {
+        stream_tx_request(s);
+    }
+
+    return CUPKEE_OK;
+}
+
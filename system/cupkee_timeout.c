@@ -19,34 +19,304 @@
 
 #include <cupkee.h>
 
-
-static cupkee_timeout_t *timeout_head = NULL;
+/* Hierarchical timing wheel.
+ *
+ * Timeout expire in 2^BITS ticks is hung in level 0, on the slot of its
+ * expire tick. Others are in higher level, on the slot of expire tick >>
+ * (BITS * level), and moved down when wheel come to that slot (cascade).
+ * So each tick only timeouts of the tick and one cascade occasionally are
+ * touched, whatever number of timeouts alive.
+ */
+#define WHEEL_BITS      CUPKEE_TIMEOUT_WHEEL_BITS
+#define WHEEL_LEVELS    CUPKEE_TIMEOUT_WHEEL_LEVELS
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_SPAN      (1u << (WHEEL_BITS * WHEEL_LEVELS))
+
+static cupkee_timeout_t *timeout_wheel[WHEEL_LEVELS][WHEEL_SIZE];
+// Id index, in static buckets till grown from heap
+static cupkee_timeout_t *timeout_id_base[CUPKEE_TIMEOUT_ID_HASH];
+static cupkee_timeout_t **timeout_ids = timeout_id_base;
+static uint32_t timeout_id_mask = CUPKEE_TIMEOUT_ID_HASH - 1;
+static int timeout_id_walking = 0;      // index walked by clear, not to grow
+static uint32_t timeout_ticks = 0;      // ticks of wheel, processed already
+static int timeout_count = 0;
 static int timeout_next = 0;
 
-static int timeout_clear_by(int (*fn)(cupkee_timeout_t *, int), int x)
+// Timeout in handling, released after handler return
+static cupkee_timeout_t *timeout_curr = NULL;
+static int timeout_curr_drop = 0;
+static uint32_t timeout_curr_missed = 0;
+
+static inline void timeout_link(cupkee_timeout_t **head, cupkee_timeout_t *t)
+{
+    t->next = *head;
+    t->pprev = head;
+    if (*head) {
+        (*head)->pprev = &t->next;
+    }
+    *head = t;
+}
+
+static inline void timeout_unlink(cupkee_timeout_t *t)
+{
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+}
+
+static void timeout_wheel_add(cupkee_timeout_t *t)
 {
-    cupkee_timeout_t *prev = NULL, *curr = timeout_head;
-    int n = 0;
+    uint32_t delta = t->expire - timeout_ticks;
+    uint32_t at = t->expire;
+    int level = 0;
+
+    if (delta >= WHEEL_SPAN) {
+        // Too far, wait in the last level and placed again
+        delta = WHEEL_SPAN - 1;
+        at = timeout_ticks + delta;
+    }
 
-    while (curr) {
-        cupkee_timeout_t *next = curr->next;
+    while (delta >> (WHEEL_BITS * (level + 1))) {
+        level++;
+    }
 
-        if (fn(curr, x)) {
-            if (prev) {
-                prev->next = next;
-            } else {
-                timeout_head = next;
+    timeout_link(&timeout_wheel[level][(at >> (WHEEL_BITS * level)) & WHEEL_MASK], t);
+}
+
+static void timeout_arm(cupkee_timeout_t *t, uint32_t expire)
+{
+    // Expired already, take it at next tick
+    if ((int32_t)(expire - timeout_ticks) <= 0) {
+        expire = timeout_ticks + 1;
+    }
+    t->expire = expire;
+    timeout_wheel_add(t);
+}
+
+static void timeout_cascade(uint32_t tick)
+{
+    int level;
+
+    for (level = 1; level < WHEEL_LEVELS; level++) {
+        int slot = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        cupkee_timeout_t *t = timeout_wheel[level][slot];
+
+        timeout_wheel[level][slot] = NULL;
+        while (t) {
+            cupkee_timeout_t *next = t->next;
+
+            timeout_wheel_add(t);
+            t = next;
+        }
+
+        if (slot) {
+            break;
+        }
+    }
+}
+
+/* Nearest tick something to do in wheel: expire tick of the nearest timeout
+ * if exact, else tick of the nearest expire or cascade.
+ */
+static uint32_t timeout_wheel_next(int exact)
+{
+    uint32_t best = CUPKEE_TICKS_FOREVER;
+    int level;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        uint32_t block = timeout_ticks >> shift;
+        uint32_t d;
+
+        for (d = 1; d <= WHEEL_SIZE; d++) {
+            cupkee_timeout_t *t = timeout_wheel[level][(block + d) & WHEEL_MASK];
+            uint32_t at;
+
+            if (!t) {
+                continue;
             }
 
-            curr->handle(1, curr->param); // drop timer
-            cupkee_free(curr);
-            n ++;
-        } else {
-            prev = curr;
+            at = ((block + d) << shift) - timeout_ticks;
+            if (exact && level) {
+                for (at = CUPKEE_TICKS_FOREVER; t; t = t->next) {
+                    if (t->expire - timeout_ticks < at) {
+                        at = t->expire - timeout_ticks;
+                    }
+                }
+            }
+            if (at < best) {
+                best = at;
+            }
+            break;
         }
+    }
+
+    return timeout_ticks + best;
+}
+
+static void timeout_id_link(cupkee_timeout_t *t)
+{
+    cupkee_timeout_t **head = &timeout_ids[t->id & timeout_id_mask];
+
+    t->id_next = *head;
+    t->id_pprev = head;
+    if (*head) {
+        (*head)->id_pprev = &t->id_next;
+    }
+    *head = t;
+}
+
+static void timeout_id_grow(void)
+{
+    uint32_t size = (timeout_id_mask + 1) * 2;
+    cupkee_timeout_t **old = timeout_ids;
+    uint32_t i;
+
+    if (size > CUPKEE_TIMEOUT_ID_HASH_MAX) {
+        return;
+    }
 
-        curr = next;
+    timeout_ids = cupkee_malloc(size * sizeof(cupkee_timeout_t *));
+    if (!timeout_ids) {
+        // Keep going with longer chains
+        timeout_ids = old;
+        return;
     }
+    memset(timeout_ids, 0, size * sizeof(cupkee_timeout_t *));
+    timeout_id_mask = size - 1;
+
+    for (i = 0; i < size / 2; i++) {
+        cupkee_timeout_t *t = old[i];
+
+        while (t) {
+            cupkee_timeout_t *next = t->id_next;
+
+            timeout_id_link(t);
+            t = next;
+        }
+    }
+
+    if (old != timeout_id_base) {
+        cupkee_free(old);
+    }
+}
+
+static cupkee_timeout_t *timeout_find(uint32_t id)
+{
+    cupkee_timeout_t *t = timeout_ids[id & timeout_id_mask];
+
+    while (t && t->id != (int)id) {
+        t = t->id_next;
+    }
+    return t;
+}
+
+static void timeout_release(cupkee_timeout_t *t)
+{
+    *t->id_pprev = t->id_next;
+    if (t->id_next) {
+        t->id_next->id_pprev = t->id_pprev;
+    }
+    timeout_count--;
+
+    t->handle(1, t->param); // drop timer
+    cupkee_free(t);
+}
+
+static void timeout_remove(cupkee_timeout_t *t)
+{
+    if (t == timeout_curr) {
+        // Clear in its own handler
+        timeout_curr_drop = 1;
+    } else {
+        timeout_unlink(t);
+        timeout_release(t);
+    }
+}
+
+static void timeout_fire(cupkee_timeout_t *t, uint32_t curr_ticks)
+{
+    uint32_t late = curr_ticks - t->expire;
+    uint32_t missed = t->wait ? late / t->wait : 0;
+    uint32_t expire = t->expire + t->wait;
+
+    if (!(t->flags & CUPKEE_FLAG_CATCHUP)) {
+        // Next deadline after now, on the same period grid
+        expire += missed * t->wait;
+    }
+
+    timeout_curr = t;
+    timeout_curr_drop = 0;
+    timeout_curr_missed = missed;
+
+    t->handle(0, t->param);       // wake up
+
+    timeout_curr = NULL;
+    if ((t->flags & CUPKEE_FLAG_REPEAT) && !timeout_curr_drop) {
+        timeout_arm(t, expire);
+    } else {
+        timeout_release(t);
+    }
+}
+
+static void timeout_tick(uint32_t curr_ticks)
+{
+    uint32_t tick = ++timeout_ticks;
+    cupkee_timeout_t *head, *t;
+
+    if (!(tick & WHEEL_MASK)) {
+        timeout_cascade(tick);
+    }
+
+    // Take out the slot, handler may register or clear others
+    head = timeout_wheel[0][tick & WHEEL_MASK];
+    timeout_wheel[0][tick & WHEEL_MASK] = NULL;
+    if (head) {
+        head->pprev = &head;
+    }
+
+    while ((t = head) != NULL) {
+        timeout_unlink(t);
+        timeout_fire(t, curr_ticks);
+    }
+}
+
+/* Drop handler may register or clear others, so the matched are marked
+ * first, and each bucket is walked again after a remove. Index is not grown
+ * meanwhile, timeouts registered by handler are not marked.
+ */
+static int timeout_clear_by(int (*fn)(cupkee_timeout_t *, int), int x)
+{
+    int i, n = 0;
+
+    for (i = 0; i <= (int)timeout_id_mask; i++) {
+        cupkee_timeout_t *curr;
+
+        for (curr = timeout_ids[i]; curr; curr = curr->id_next) {
+            curr->drop = fn(curr, x);
+        }
+    }
+
+    timeout_id_walking++;
+    for (i = 0; i <= (int)timeout_id_mask; i++) {
+        cupkee_timeout_t *curr = timeout_ids[i];
+
+        while (curr) {
+            if (curr->drop) {
+                curr->drop = 0;
+                timeout_remove(curr);
+                n ++;
+
+                curr = timeout_ids[i];
+            } else {
+                curr = curr->id_next;
+            }
+        }
+    }
+    timeout_id_walking--;
+
     return n;
 }
 
@@ -55,45 +325,56 @@ static int timeout_with_flag(cupkee_timeout_t *t, int flags)
     return t->flags == flags;
 }
 
-static int timeout_with_id(cupkee_timeout_t *t, int id)
+static int timeout_any(cupkee_timeout_t *t, int x)
 {
-    return t->id == id;
+    (void) t;
+    (void) x;
+
+    return 1;
 }
 
 void cupkee_timeout_setup(void)
 {
-    timeout_head = NULL;
+    memset(timeout_wheel, 0, sizeof(timeout_wheel));
+    // Grown index is gone with heap
+    memset(timeout_id_base, 0, sizeof(timeout_id_base));
+    timeout_ids = timeout_id_base;
+    timeout_id_mask = CUPKEE_TIMEOUT_ID_HASH - 1;
+    timeout_id_walking = 0;
+    timeout_ticks = _cupkee_systicks;
+    timeout_count = 0;
     timeout_next = 0;
+    timeout_curr = NULL;
 }
 
 void cupkee_timeout_sync(uint32_t curr_ticks)
 {
-    cupkee_timeout_t *prev = NULL, *curr = timeout_head;
-
-    while (curr) {
-        cupkee_timeout_t *next = curr->next;
-
-        if (curr_ticks - curr->from >= curr->wait) {
-            curr->handle(0, curr->param);       // wake up
+    while (timeout_count && (int32_t)(curr_ticks - timeout_ticks) > 0) {
+        if (curr_ticks - timeout_ticks > 1) {
+            // Ticks skipped (idle), jump over empty slots
+            uint32_t next = timeout_wheel_next(0);
 
-            if (curr->flags & CUPKEE_FLAG_REPEAT) {
-                curr->from = curr_ticks;
-                prev = curr;
-            } else {
-                curr->handle(1, curr->param);   // drop
-                if (prev) {
-                    prev->next = next;
-                } else {
-                    // Current timer is header
-                    timeout_head = next;
-                }
-                cupkee_free(curr);
+            if ((int32_t)(next - curr_ticks) > 0) {
+                break;
             }
-        } else {
-            prev = curr;
+            timeout_ticks = next - 1;
         }
-        curr = next;
+        timeout_tick(curr_ticks);
+    }
+
+    timeout_ticks = curr_ticks;
+}
+
+uint32_t cupkee_timeout_next(uint32_t curr_ticks)
+{
+    uint32_t next;
+
+    if (!timeout_count) {
+        return CUPKEE_TICKS_FOREVER;
     }
+
+    next = timeout_wheel_next(1);
+    return (int32_t)(next - curr_ticks) > 0 ? next - curr_ticks : 0;
 }
 
 cupkee_timeout_t *cupkee_timeout_register(uint32_t wait, int flags, cupkee_timeout_handle_t handle, void *param)
@@ -106,15 +387,25 @@ cupkee_timeout_t *cupkee_timeout_register(uint32_t wait, int flags, cupkee_timeo
 
     t = cupkee_malloc(sizeof(cupkee_timeout_t));
     if (t) {
+        if (!timeout_count) {
+            // Wheel is idle, catch up with systicks
+            timeout_ticks = _cupkee_systicks;
+        }
+
         t->handle = handle;
         t->param  = param;
         t->id     = timeout_next++;
         t->wait   = wait;
-        t->from   = _cupkee_systicks;
         t->flags  = flags;
+        t->drop   = 0;
 
-        t->next = timeout_head;
-        timeout_head = t;
+        if (!timeout_id_walking && timeout_count >= (int)(timeout_id_mask + 1) * CUPKEE_TIMEOUT_ID_LOAD) {
+            timeout_id_grow();
+        }
+        timeout_id_link(t);
+        timeout_count++;
+
+        timeout_arm(t, _cupkee_systicks + wait);
     }
 
     return t;
@@ -122,44 +413,21 @@ cupkee_timeout_t *cupkee_timeout_register(uint32_t wait, int flags, cupkee_timeo
 
 void cupkee_timeout_unregister(cupkee_timeout_t *t)
 {
-    cupkee_timeout_t *prev = NULL, *curr = timeout_head;
-
-    while (curr) {
-        if (curr == t) {
-            if (prev) {
-                prev->next = curr->next;
-            } else {
-                timeout_head = curr->next;
-            }
-
-            curr->handle(1, curr->param); // drop timer
-            cupkee_free(curr);
-
-            return;
-        }
-
-        prev = curr;
-        curr = curr->next;
+    // Handle may be released already: memory of it is still in cupkee heap,
+    // only removed if the id in it lead back to itself
+    if (t && timeout_find(t->id) == t) {
+        timeout_remove(t);
     }
 }
 
-int cupkee_timeout_clear_all(void)
+uint32_t cupkee_timeout_missed(void)
 {
-    cupkee_timeout_t *curr = timeout_head;
-    int n = 0;
-
-    timeout_head = NULL;
-    while (curr) {
-        cupkee_timeout_t *next = curr->next;
-
-        curr->handle(1, curr->param); // drop timer
-        cupkee_free(curr);
-
-        curr = next;
-        n ++;
-    }
+    return timeout_curr ? timeout_curr_missed : 0;
+}
 
-    return n;
+int cupkee_timeout_clear_all(void)
+{
+    return timeout_clear_by(timeout_any, 0);
 }
 
 int cupkee_timeout_clear_with_flags(uint32_t flags)
@@ -169,7 +437,13 @@ int cupkee_timeout_clear_with_flags(uint32_t flags)
 
 int cupkee_timeout_clear_with_id(uint32_t id)
 {
-    return timeout_clear_by(timeout_with_id, id);
+    cupkee_timeout_t *t = timeout_find(id);
+
+    if (t) {
+        timeout_remove(t);
+        return 1;
+    }
+    return 0;
 }
 
 volatile uint32_t _cupkee_systicks;
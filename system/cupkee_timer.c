@@ -93,7 +93,7 @@ static const cupkee_desc_t timer_desc = {
 
 int cupkee_timer_setup(void)
 {
-    if (0 >= (timer_tag = cupkee_object_register(sizeof(cupkee_timer_t), &timer_desc))) {
+    if (0 >= (timer_tag = cupkee_object_register(sizeof(cupkee_timer_t), &timer_desc, CUPKEE_TIMER_RESERVE))) {
         return -1;
     }
 
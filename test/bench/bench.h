@@ -0,0 +1,43 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#ifndef __BENCH_INC__
+#define __BENCH_INC__
+
+#include <cupkee.h>
+
+#include "hw_mock.h"
+
+static inline uint32_t bench_rand(uint32_t *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) & 0x7fff;
+}
+
+uint64_t bench_now_ns(void);
+
+void bench_report(const char *name, const char *item, double value, const char *unit);
+
+void bench_memory(void);
+void bench_object(void);
+void bench_event(void);
+void bench_timeout(void);
+void bench_stream(void);
+void bench_replay(const char *path, size_t heap);
+
+#endif /* __BENCH_INC__ */
@@ -0,0 +1,179 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "bench.h"
+
+#define HEAP_SIZE       (16 * 1024)
+#define QUEUE_DEPTH     (16)
+#define PAIR_STEPS      (1000000)
+#define DRAIN_ROUNDS    (200000)
+#define DRAIN_BATCH     (8)
+#define PRODUCER_MAX    (4)
+#define PRODUCER_EVENTS (200000)
+
+#if CUPKEE_EVENTQ_LOCKFREE
+#define QUEUE_MODE      "lockfree"
+#else
+#define QUEUE_MODE      "critical"
+#endif
+
+static uint32_t producer_retry[PRODUCER_MAX];
+
+static void *event_producer(void *arg)
+{
+    uintptr_t which = (uintptr_t)arg;
+    uint32_t retry = 0;
+    int i;
+
+    for (i = 0; i < PRODUCER_EVENTS; i++) {
+        while (!cupkee_event_post(EVENT_OBJECT, (uint8_t)i, which)) {
+            retry++;
+            sched_yield();
+        }
+    }
+    producer_retry[which] = retry;
+
+    return NULL;
+}
+
+/* Cost of post & take without contention, the part run in interrupt */
+static void event_pair(void)
+{
+    cupkee_event_t e;
+    uint64_t start, cost;
+    int i;
+
+    cupkee_event_setup(QUEUE_DEPTH, 0, 0);
+
+    start = bench_now_ns();
+    for (i = 0; i < PAIR_STEPS; i++) {
+        cupkee_event_post(EVENT_OBJECT, i, 0);
+        cupkee_event_take(&e);
+    }
+    cost = bench_now_ns() - start;
+
+    bench_report(QUEUE_MODE, "post & take", (double)cost / PAIR_STEPS, "ns");
+}
+
+/* Drain a full queue, one by one or in batch, as main loop does */
+static void event_drain(int batch)
+{
+    cupkee_event_t events[DRAIN_BATCH];
+    uint64_t start, cost = 0;
+    uint32_t sum = 0;
+    int round, i, n;
+
+    cupkee_event_setup(QUEUE_DEPTH, 0, 0);
+
+    for (round = 0; round < DRAIN_ROUNDS; round++) {
+        for (i = 0; i < QUEUE_DEPTH; i++) {
+            cupkee_event_post(EVENT_OBJECT, i, round);
+        }
+
+        start = bench_now_ns();
+        if (batch) {
+            while ((n = cupkee_event_take_batch(events, DRAIN_BATCH)) > 0) {
+                for (i = 0; i < n; i++) {
+                    sum += events[i].code;
+                }
+            }
+        } else {
+            while (cupkee_event_take(&events[0])) {
+                sum += events[0].code;
+            }
+        }
+        cost += bench_now_ns() - start;
+    }
+
+    if (sum != (uint32_t)DRAIN_ROUNDS * (QUEUE_DEPTH * (QUEUE_DEPTH - 1) / 2)) {
+        printf("  drain lost events!\n");
+    }
+    bench_report(QUEUE_MODE, batch ? "drain in batch" : "drain one by one",
+                 (double)cost / (DRAIN_ROUNDS * QUEUE_DEPTH), "ns/event");
+}
+
+/* Producer threads post to one queue, drained by main thread */
+static void event_producers(int n)
+{
+    pthread_t producers[PRODUCER_MAX];
+    uint8_t next[PRODUCER_MAX];
+    uint64_t start, cost;
+    uint32_t retry = 0;
+    int i, taken = 0, disorder = 0;
+    cupkee_event_t e;
+    char item[32];
+
+    cupkee_event_setup(QUEUE_DEPTH, 0, 0);
+    memset(next, 0, sizeof(next));
+
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        pthread_create(&producers[i], NULL, event_producer, (void *)(uintptr_t)i);
+    }
+
+    while (taken < n * PRODUCER_EVENTS) {
+        if (!cupkee_event_take(&e)) {
+            sched_yield();
+            continue;
+        }
+        if (e.which >= n || e.code != next[e.which]) {
+            disorder++;
+        } else {
+            next[e.which]++;
+        }
+        taken++;
+    }
+
+    for (i = 0; i < n; i++) {
+        pthread_join(producers[i], NULL);
+        retry += producer_retry[i];
+    }
+    cost = bench_now_ns() - start;
+
+    snprintf(item, sizeof(item), "%d producers throughput", n);
+    bench_report(QUEUE_MODE, item, (double)taken * 1000.0 / cost, "Mev/s");
+    snprintf(item, sizeof(item), "%d producers full retry", n);
+    bench_report(QUEUE_MODE, item, retry, "times");
+    snprintf(item, sizeof(item), "%d producers disorder", n);
+    bench_report(QUEUE_MODE, item, disorder, "events");
+}
+
+void bench_event(void)
+{
+    int n;
+
+    printf("Bench: event\n");
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    event_pair();
+    event_drain(0);
+    event_drain(1);
+    for (n = 1; n <= PRODUCER_MAX; n <<= 1) {
+        event_producers(n);
+    }
+
+    hw_mock_deinit();
+}
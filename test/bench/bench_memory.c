@@ -0,0 +1,308 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define HEAP_SIZE       (40 * 1024)
+#define TRACE_SLOTS     (384)
+#define TRACE_STEPS     (200000)
+#define TRACE_ROUNDS    (10)
+
+static void *trace_slots[TRACE_SLOTS];
+
+static int memory_free_pages(void)
+{
+    int order, n = 0;
+
+    for (order = 0; order < CUPKEE_PAGE_ORDERR_MAX; order++) {
+        n += cupkee_free_pages(order) << order;
+    }
+
+    return n;
+}
+
+static size_t trace_size(uint32_t *seed)
+{
+    uint32_t r = bench_rand(seed);
+
+    // Most objects are small, a few are larger
+    if (r & 0x3) {
+        return 8 + r % 56;
+    } else {
+        return 64 + r % 192;
+    }
+}
+
+/* Randomized alloc/free trace with a bounded live set.
+ * Return the number of failed allocations, and the peak pages in use when
+ * 'peak' is given (page accounting is not timed).
+ */
+static int memory_trace(uint32_t seed, int *peak)
+{
+    int total = memory_free_pages();
+    int step, fails = 0;
+
+    memset(trace_slots, 0, sizeof(trace_slots));
+
+    for (step = 0; step < TRACE_STEPS; step++) {
+        int i = bench_rand(&seed) % TRACE_SLOTS;
+
+        if (trace_slots[i]) {
+            cupkee_free(trace_slots[i]);
+            trace_slots[i] = NULL;
+        } else {
+            trace_slots[i] = cupkee_malloc(trace_size(&seed));
+            if (!trace_slots[i]) {
+                fails++;
+            }
+        }
+
+        if (peak) {
+            int used = total - memory_free_pages();
+            if (used > *peak) {
+                *peak = used;
+            }
+        }
+    }
+
+    for (step = 0; step < TRACE_SLOTS; step++) {
+        if (trace_slots[step]) {
+            cupkee_free(trace_slots[step]);
+        }
+    }
+
+    return fails;
+}
+
+static void bench_memory_churn(void)
+{
+    uint64_t start, cost;
+    int round, peak = 0, fails = 0;
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    fails = memory_trace(1, &peak);
+
+    start = bench_now_ns();
+    for (round = 0; round < TRACE_ROUNDS; round++) {
+        memory_trace(round + 1, NULL);
+    }
+    cost = bench_now_ns() - start;
+
+    bench_report("memory churn", "peak pages", peak, "pages");
+    bench_report("memory churn", "failed allocs", fails, "times");
+    bench_report("memory churn", "alloc/free throughput",
+                 (double)TRACE_STEPS * TRACE_ROUNDS * 1000.0 / cost, "Mops/s");
+
+    hw_mock_deinit();
+}
+
+static size_t occupancy_size(uint32_t *seed)
+{
+    uint32_t r = bench_rand(seed);
+
+    switch (r & 0x7) {
+    case 0: case 1: case 2: return 8 + r % 40;
+    case 3: case 4: return 48 + r % 80;
+    case 5: case 6: return 128 + r % 256;
+    default: return 384 + r % 256;
+    }
+}
+
+/* Fill the heap with a random size mix until allocation fails,
+ * occupancy is the ratio of requested bytes to the bytes of used pages.
+ */
+static void bench_memory_occupancy(void)
+{
+    uint32_t seed = 1;
+    size_t requested = 0;
+    int total, used, objects = 0;
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    total = memory_free_pages();
+    while (1) {
+        size_t size = occupancy_size(&seed);
+
+        if (!cupkee_malloc(size)) {
+            break;
+        }
+        requested += size;
+        objects++;
+    }
+    used = total - memory_free_pages();
+
+    bench_report("memory occupancy", "objects until full", objects, "objects");
+    bench_report("memory occupancy", "requested", requested, "bytes");
+    bench_report("memory occupancy", "pages used", used, "pages");
+    bench_report("memory occupancy", "occupancy",
+                 requested * 100.0 / (used * CUPKEE_PAGE_SIZE), "%");
+
+    hw_mock_deinit();
+}
+
+#define PINGPONG_TIMES   (1000000)
+
+static double memory_pingpong(int cache)
+{
+    uint64_t start, cost;
+    int i;
+
+    cupkee_memory_cache_set(0, cache);
+
+    start = bench_now_ns();
+    for (i = 0; i < PINGPONG_TIMES; i++) {
+        cupkee_free(cupkee_malloc(32));
+    }
+    cost = bench_now_ns() - start;
+
+    return PINGPONG_TIMES * 1000.0 / cost;
+}
+
+/* One object alloc & free per message */
+static void bench_memory_pingpong(void)
+{
+    uint32_t kept, reused;
+    double nocache;
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    nocache = memory_pingpong(0);
+    bench_report("memory pingpong", "no cache", nocache, "Mops/s");
+
+    bench_report("memory pingpong", "cache 1 page", memory_pingpong(1), "Mops/s");
+    cupkee_memory_cache_stat(&kept, &reused);
+    bench_report("memory pingpong", "buddy free avoided", kept, "times");
+    bench_report("memory pingpong", "buddy alloc avoided", reused, "times");
+
+    hw_mock_deinit();
+}
+
+#define LOOKUP_TIMES     (10000000)
+
+static uint8_t lookup_region[16 * 1024];
+
+static double memory_lookup(void *p)
+{
+    uint64_t start, cost;
+    intptr_t sum = 0;
+    int i;
+
+    start = bench_now_ns();
+    for (i = 0; i < LOOKUP_TIMES; i++) {
+        sum += (intptr_t)cupkee_memory_page((uint8_t *)p + (i & 0xff));
+    }
+    cost = bench_now_ns() - start;
+
+    return sum ? (double)cost / LOOKUP_TIMES : 0;
+}
+
+/* Pointer to page lookup, cost of cupkee_free */
+static void bench_memory_lookup(void)
+{
+    void *boot, *ext;
+    int zone;
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    zone = cupkee_memory_extend((intptr_t)lookup_region, sizeof(lookup_region));
+    cupkee_memory_prefer(zone, 1);
+    ext = cupkee_malloc(64);
+    cupkee_memory_prefer(0, 2);
+    boot = cupkee_malloc(64);
+
+    bench_report("memory lookup", "boot zone", memory_lookup(boot), "ns");
+    bench_report("memory lookup", "extend zone", memory_lookup(ext), "ns");
+
+    hw_mock_deinit();
+}
+
+#define STORM_SLOTS      (24)
+#define STORM_STEPS      (2000000)
+
+/* Page sized allocations only, random orders with a bounded live set */
+static void bench_memory_storm(void)
+{
+    cupkee_page_t *slots[STORM_SLOTS];
+    uint64_t start, cost;
+    uint32_t seed = 1;
+    int step, fails = 0;
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    memset(slots, 0, sizeof(slots));
+
+    start = bench_now_ns();
+    for (step = 0; step < STORM_STEPS; step++) {
+        uint32_t r = bench_rand(&seed);
+        int i = r % STORM_SLOTS;
+
+        if (slots[i]) {
+            cupkee_page_free(slots[i]);
+            slots[i] = NULL;
+        } else {
+            // Order 0 mostly, up to order 3
+            int order = (r >> 8) & 0x3;
+
+            order = order == 3 ? (r >> 10) & 0x3 : 0;
+            if (NULL == (slots[i] = cupkee_page_alloc(order))) {
+                fails++;
+            }
+        }
+    }
+    cost = bench_now_ns() - start;
+
+    for (step = 0; step < STORM_SLOTS; step++) {
+        if (slots[step]) {
+            cupkee_page_free(slots[step]);
+        }
+    }
+
+    start = bench_now_ns();
+    for (step = 0; step < STORM_STEPS; step++) {
+        fails += cupkee_free_pages(step % CUPKEE_PAGE_ORDERR_MAX) < 0;
+    }
+
+    bench_report("memory storm", "failed allocs", fails, "times");
+    bench_report("memory storm", "page alloc/free throughput",
+                 (double)STORM_STEPS * 1000.0 / cost, "Mops/s");
+    bench_report("memory storm", "free pages query",
+                 (double)(bench_now_ns() - start) / STORM_STEPS, "ns");
+
+    hw_mock_deinit();
+}
+
+void bench_memory(void)
+{
+    printf("Bench: memory\n");
+
+    bench_memory_churn();
+    bench_memory_occupancy();
+    bench_memory_pingpong();
+    bench_memory_lookup();
+    bench_memory_storm();
+}
@@ -0,0 +1,115 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define HEAP_SIZE       (40 * 1024)
+#define CHURN_SLOTS     (16)
+#define CHURN_STEPS     (1000000)
+
+typedef struct churn_entry_t {
+    intptr_t data[6];
+} churn_entry_t;
+
+static const cupkee_desc_t churn_desc = {
+    .name = "churn"
+};
+
+static cupkee_object_t *churn_slots[CHURN_SLOTS];
+
+static int memory_free_pages(void)
+{
+    int order, n = 0;
+
+    for (order = 0; order < CUPKEE_PAGE_ORDERR_MAX; order++) {
+        n += cupkee_free_pages(order) << order;
+    }
+
+    return n;
+}
+
+/* Objects of one tag are created and destroyed randomly, mixed with
+ * general allocations of other size, as timers and devices do in system.
+ */
+static void object_churn(const char *item, int reserve)
+{
+    uint64_t start, cost;
+    uint32_t seed = 1;
+    void *noise[CHURN_SLOTS];
+    int tag, step, total, peak = 0, fails = 0;
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+    cupkee_object_setup();
+
+    total = memory_free_pages();
+    tag = cupkee_object_register(sizeof(churn_entry_t), &churn_desc, reserve);
+
+    memset(churn_slots, 0, sizeof(churn_slots));
+    memset(noise, 0, sizeof(noise));
+
+    start = bench_now_ns();
+    for (step = 0; step < CHURN_STEPS; step++) {
+        uint32_t r = bench_rand(&seed);
+        int i = r % CHURN_SLOTS;
+
+        if (r & 0x100) {
+            if (noise[i]) {
+                cupkee_free(noise[i]);
+                noise[i] = NULL;
+            } else {
+                noise[i] = cupkee_malloc(16 + (r >> 9) % 48);
+            }
+        } else
+        if (churn_slots[i]) {
+            cupkee_object_destroy(churn_slots[i]);
+            churn_slots[i] = NULL;
+        } else {
+            churn_slots[i] = cupkee_object_create(tag);
+            if (!churn_slots[i]) {
+                fails++;
+            }
+        }
+
+        if ((step & 0xff) == 0) {
+            int used = total - memory_free_pages();
+            if (used > peak) {
+                peak = used;
+            }
+        }
+    }
+    cost = bench_now_ns() - start;
+
+    bench_report(item, "failed creates", fails, "times");
+    bench_report(item, "peak pages", peak, "pages");
+    bench_report(item, "steps throughput", (double)CHURN_STEPS * 1000.0 / cost, "Mops/s");
+
+    hw_mock_deinit();
+}
+
+void bench_object(void)
+{
+    printf("Bench: object\n");
+
+    object_churn("object unpooled", 0);
+    object_churn("object pooled", CHURN_SLOTS);
+}
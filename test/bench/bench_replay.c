@@ -0,0 +1,207 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+/* Replay memory trace dumped by native memtrace(), one record per line:
+ *   tick op size order ptr prev
+ * op: 0 alloc, 1 free, 2 realloc; ptr & prev in hex; '#' for comment
+ */
+
+#define REPLAY_HEAP_DEF     (40 * 1024)
+#define REPLAY_REC_MAX      (1024 * 1024)
+#define REPLAY_MAP_SIZE     (4096)
+#define REPLAY_FAIL_SHOW    (8)
+
+typedef struct replay_map_t {
+    uintptr_t trace;
+    void     *replay;
+} replay_map_t;
+
+static cupkee_memory_trace_t *replay_recs;
+static replay_map_t replay_map[REPLAY_MAP_SIZE];
+
+static replay_map_t *replay_map_find(uintptr_t trace, int add)
+{
+    unsigned i = (trace >> 3) % REPLAY_MAP_SIZE;
+    unsigned n;
+
+    for (n = 0; n < REPLAY_MAP_SIZE; n++, i = (i + 1) % REPLAY_MAP_SIZE) {
+        if (replay_map[i].trace == trace) {
+            return &replay_map[i];
+        }
+        if (!replay_map[i].trace) {
+            return add ? &replay_map[i] : NULL;
+        }
+    }
+    return NULL;
+}
+
+static void replay_map_del(replay_map_t *m)
+{
+    // Tombstone keeps probe chain, '1' is never a memory address
+    m->trace = 1;
+    m->replay = NULL;
+}
+
+static int replay_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    int n = 0;
+
+    if (!fp) {
+        printf("  can not open trace: %s\n", path);
+        return -1;
+    }
+
+    while (n < REPLAY_REC_MAX && fgets(line, sizeof(line), fp)) {
+        cupkee_memory_trace_t *rec = &replay_recs[n];
+        unsigned tick, op, size, order;
+        unsigned long ptr, prev;
+
+        if (line[0] == '#') {
+            continue;
+        }
+        if (6 != sscanf(line, "%u %u %u %u %lx %lx", &tick, &op, &size, &order, &ptr, &prev)) {
+            continue;
+        }
+
+        rec->tick  = tick;
+        rec->op    = op;
+        rec->size  = size;
+        rec->order = order;
+        rec->ptr   = ptr;
+        rec->prev  = prev;
+        n++;
+    }
+    fclose(fp);
+
+    return n;
+}
+
+static void replay_fail(int *fails, int i, cupkee_memory_trace_t *rec)
+{
+    if ((*fails)++ < REPLAY_FAIL_SHOW) {
+        printf("  fail at record %d, tick %u, size %u\n", i, (unsigned)rec->tick, (unsigned)rec->size);
+    }
+}
+
+/* Return steps done, count of failure and peak bytes by arguments */
+static int replay_run(int num, int *fails, uint32_t *peak)
+{
+    cupkee_memory_stat_t stat;
+    int i;
+
+    memset(replay_map, 0, sizeof(replay_map));
+    *fails = 0;
+
+    for (i = 0; i < num; i++) {
+        cupkee_memory_trace_t *rec = &replay_recs[i];
+        replay_map_t *m;
+        void *p;
+
+        switch (rec->op) {
+        case CUPKEE_TRACE_ALLOC:
+            if (!rec->ptr) {
+                break; // Failed in trace too
+            }
+            if (NULL == (p = cupkee_malloc(rec->size))) {
+                replay_fail(fails, i, rec);
+            } else
+            if (NULL != (m = replay_map_find(rec->ptr, 1))) {
+                m->trace = rec->ptr;
+                m->replay = p;
+            }
+            break;
+        case CUPKEE_TRACE_FREE:
+            if (NULL != (m = replay_map_find(rec->ptr, 0))) {
+                cupkee_free(m->replay);
+                replay_map_del(m);
+            }
+            break;
+        case CUPKEE_TRACE_REALLOC:
+            m = rec->prev ? replay_map_find(rec->prev, 0) : NULL;
+            if (rec->prev && !m) {
+                break; // Memory is not allocated in replay
+            }
+            p = cupkee_realloc(m ? m->replay : NULL, rec->size);
+            if (!p) {
+                if (rec->size) {
+                    replay_fail(fails, i, rec);
+                }
+                if (m && !rec->size) {
+                    replay_map_del(m);
+                }
+                break;
+            }
+            if (m) {
+                replay_map_del(m);
+            }
+            if (NULL != (m = replay_map_find(rec->ptr, 1))) {
+                m->trace = rec->ptr;
+                m->replay = p;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    cupkee_memory_stats(&stat);
+    *peak = stat.bytes_peak;
+
+    return i;
+}
+
+void bench_replay(const char *path, size_t heap)
+{
+    uint64_t start, cost;
+    uint32_t peak;
+    int num, fails;
+
+    printf("Bench: replay %s\n", path);
+
+    replay_recs = malloc(sizeof(cupkee_memory_trace_t) * REPLAY_REC_MAX);
+    if (!replay_recs) {
+        return;
+    }
+
+    if (0 < (num = replay_load(path))) {
+        hw_mock_init(heap ? heap : REPLAY_HEAP_DEF);
+        cupkee_memory_setup();
+
+        start = bench_now_ns();
+        replay_run(num, &fails, &peak);
+        cost = bench_now_ns() - start;
+
+        bench_report("memory replay", "records", num, "records");
+        bench_report("memory replay", "failed allocs", fails, "times");
+        bench_report("memory replay", "peak used", peak, "bytes");
+        bench_report("memory replay", "throughput", num * 1000.0 / cost, "Mops/s");
+
+        hw_mock_deinit();
+    }
+
+    free(replay_recs);
+}
@@ -0,0 +1,243 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define HEAP_SIZE       (128 * 1024)
+#define TOTAL_BYTES     (16 * 1024 * 1024)
+#define LINE_BAUDRATE   (921600)
+#define LOOP_PERIOD_US  (2000)
+#define LOOP_COUNT      (10000)
+
+static uint8_t packet[1024];
+
+/* Mock device: data is moved by bench as driver */
+static int mock_request(int inst)
+{
+    (void) inst;
+    return 0;
+}
+
+static int mock_release(int inst)
+{
+    (void) inst;
+    return 0;
+}
+
+static int mock_setup(int inst, void *entry)
+{
+    (void) inst;
+    (void) entry;
+    return 0;
+}
+
+static int mock_reset(int inst)
+{
+    (void) inst;
+    return 0;
+}
+
+static int mock_read(int inst, size_t n, void *buf)
+{
+    (void) inst;
+    (void) buf;
+    return buf ? (int)n : 0;
+}
+
+static int mock_write(int inst, size_t n, const void *data)
+{
+    (void) inst;
+    (void) data;
+    return data ? (int)n : 0;
+}
+
+static const cupkee_driver_t mock_driver = {
+    .request = mock_request,
+    .release = mock_release,
+    .setup   = mock_setup,
+    .reset   = mock_reset,
+    .read    = mock_read,
+    .write   = mock_write,
+};
+
+static const cupkee_device_desc_t mock_device = {
+    .name = "mock",
+    .inst_max = 1,
+    .driver = &mock_driver
+};
+
+/* Driver pushes packets, user reads them */
+static double stream_rx_copy(void *dev, size_t size)
+{
+    uint8_t buf[sizeof(packet)];
+    uint64_t start = bench_now_ns();
+    size_t total;
+
+    for (total = 0; total < TOTAL_BYTES; total += size) {
+        size_t off = 0;
+
+        while (off < size) {
+            off += cupkee_device_push(dev, size - off, packet + off);
+            cupkee_read(dev, size, buf);
+        }
+    }
+
+    return (double)TOTAL_BYTES * 1000 / (bench_now_ns() - start);
+}
+
+static double stream_rx_block(void *dev, size_t size)
+{
+    uint64_t start = bench_now_ns();
+    size_t total;
+
+    for (total = 0; total < TOTAL_BYTES; total += size) {
+        void *b = cupkee_block_alloc(size);
+
+        // received into block by DMA
+        cupkee_block_set_length(b, size);
+        cupkee_device_push_buf(dev, b);
+
+        cupkee_block_release(cupkee_device_read_buf(dev));
+    }
+
+    return (double)TOTAL_BYTES * 1000 / (bench_now_ns() - start);
+}
+
+/* User writes packets, driver pulls them */
+static double stream_tx_copy(void *dev, size_t size)
+{
+    uint8_t buf[sizeof(packet)];
+    uint64_t start = bench_now_ns();
+    size_t total;
+
+    for (total = 0; total < TOTAL_BYTES; total += size) {
+        size_t off = 0;
+
+        while (off < size) {
+            off += cupkee_write(dev, size - off, packet + off);
+            cupkee_device_pull(dev, size, buf);
+        }
+    }
+
+    return (double)TOTAL_BYTES * 1000 / (bench_now_ns() - start);
+}
+
+static double stream_tx_block(void *dev, size_t size)
+{
+    uint64_t start = bench_now_ns();
+    size_t total;
+
+    for (total = 0; total < TOTAL_BYTES; total += size) {
+        void *b = cupkee_block_alloc(size);
+
+        // packet built in block by user
+        cupkee_block_set_length(b, size);
+        cupkee_device_write_buf(dev, b);
+
+        cupkee_device_free_buf(dev, cupkee_device_pull_buf(dev));
+    }
+
+    return (double)TOTAL_BYTES * 1000 / (bench_now_ns() - start);
+}
+
+/* Uart at LINE_BAUDRATE, received byte by byte in interrupt, while main
+ * loop reads once every LOOP_PERIOD_US. Bytes are lost as ring overflows.
+ */
+static double stream_rx_line(void *dev)
+{
+    uint8_t buf[CUPKEE_DEVICE_STREAM_SIZE_MAX];
+    uint32_t offered = 0, received = 0, bits = 0;
+    int i;
+
+    for (i = 0; i < LOOP_COUNT; i++) {
+        bits += (uint64_t)LINE_BAUDRATE * LOOP_PERIOD_US / 1000000;
+        while (bits >= 10) {
+            bits -= 10;
+            offered++;
+            cupkee_device_push(dev, 1, packet);
+        }
+        received += cupkee_read(dev, sizeof(buf), buf);
+    }
+
+    return (double)received * 100 / offered;
+}
+
+/* Host cost of copy path, with chunk of ring size */
+static double stream_rx_ring(void *dev, size_t size)
+{
+    uint8_t buf[CUPKEE_DEVICE_STREAM_SIZE_MAX];
+    uint64_t start = bench_now_ns();
+    size_t total;
+
+    for (total = 0; total < TOTAL_BYTES; total += size) {
+        cupkee_device_push(dev, size, packet);
+        cupkee_read(dev, size, buf);
+    }
+
+    return (double)TOTAL_BYTES * 1000 / (bench_now_ns() - start);
+}
+
+void bench_stream(void)
+{
+    void *dev;
+    size_t size;
+    char item[32];
+
+    printf("Bench: stream\n");
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_init(NULL);
+    cupkee_device_register(&mock_device);
+
+    dev = cupkee_device_request("mock", 0);
+    if (!dev || cupkee_device_enable(dev)) {
+        printf("mock device enable fail\n");
+        hw_mock_deinit();
+        return;
+    }
+
+    for (size = 16; size <= sizeof(packet); size *= 4) {
+        snprintf(item, sizeof(item), "%4u bytes, rx copy", (unsigned)size);
+        bench_report("stream", item, stream_rx_copy(dev, size), "MB/s");
+        snprintf(item, sizeof(item), "%4u bytes, rx block", (unsigned)size);
+        bench_report("stream", item, stream_rx_block(dev, size), "MB/s");
+        snprintf(item, sizeof(item), "%4u bytes, tx copy", (unsigned)size);
+        bench_report("stream", item, stream_tx_copy(dev, size), "MB/s");
+        snprintf(item, sizeof(item), "%4u bytes, tx block", (unsigned)size);
+        bench_report("stream", item, stream_tx_block(dev, size), "MB/s");
+    }
+
+    // Ring grows at runtime, while idle
+    for (size = CUPKEE_DEVICE_STREAM_SIZE; size <= 512; size *= 2) {
+        if (cupkee_device_stream_resize(dev, size, size)) {
+            printf("stream resize fail\n");
+            break;
+        }
+        snprintf(item, sizeof(item), "%4u bytes ring, line rx", (unsigned)size);
+        bench_report("stream", item, stream_rx_line(dev), "%");
+        snprintf(item, sizeof(item), "%4u bytes ring, copy", (unsigned)size);
+        bench_report("stream", item, stream_rx_ring(dev, size), "MB/s");
+    }
+
+    cupkee_release(dev);
+    hw_mock_deinit();
+}
@@ -0,0 +1,153 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define HEAP_SIZE       (256 * 1024)
+#define TIMEOUT_MAX     (1000)
+#define SYNC_TICKS      (100000)
+#define CANCEL_STEPS    (100000)
+
+static uint32_t fired;
+
+static void timeout_handle(int drop, void *param)
+{
+    (void) param;
+
+    if (!drop) {
+        fired++;
+    }
+}
+
+static void timeout_start(int n, uint32_t *seed)
+{
+    int i;
+
+    _cupkee_systicks = 0;
+    cupkee_timeout_setup();
+
+    // setInterval with period of 10ms ~ 10s
+    for (i = 0; i < n; i++) {
+        uint32_t wait = 10 + bench_rand(seed) % 10000;
+
+        cupkee_timeout_register(wait, CUPKEE_FLAG_REPEAT, timeout_handle, NULL);
+    }
+}
+
+/* Cost of each systick with n repeating timeouts alive */
+static void timeout_ticks(int n)
+{
+    uint32_t seed = 1;
+    uint64_t start, cost;
+    char item[32];
+
+    timeout_start(n, &seed);
+
+    fired = 0;
+    start = bench_now_ns();
+    while (_cupkee_systicks < SYNC_TICKS) {
+        cupkee_timeout_sync(++_cupkee_systicks);
+    }
+    cost = bench_now_ns() - start;
+
+    snprintf(item, sizeof(item), "%4d timeouts, per tick", n);
+    bench_report("timeout", item, (double)cost / SYNC_TICKS, "ns");
+    snprintf(item, sizeof(item), "%4d timeouts, fired", n);
+    bench_report("timeout", item, fired, "times");
+
+    cupkee_timeout_clear_all();
+}
+
+/* Cost of setTimeout & clearTimeout with n timeouts alive */
+static void timeout_cancel(int n)
+{
+    uint32_t seed = 2;
+    uint64_t start, cost;
+    char item[32];
+    int i;
+
+    timeout_start(n, &seed);
+
+    start = bench_now_ns();
+    for (i = 0; i < CANCEL_STEPS; i++) {
+        cupkee_timeout_t *t = cupkee_timeout_register(100, 0, timeout_handle, NULL);
+
+        cupkee_timeout_clear_with_id(t->id);
+    }
+    cost = bench_now_ns() - start;
+
+    snprintf(item, sizeof(item), "%4d timeouts, set & clear", n);
+    bench_report("timeout", item, (double)cost / CANCEL_STEPS, "ns");
+
+    cupkee_timeout_clear_all();
+}
+
+/* Cost of clearTimeout by id, with n timeouts alive */
+static void timeout_cancel_id(int n)
+{
+    static int ids[TIMEOUT_MAX];
+    uint32_t seed = 3;
+    uint64_t start, cost;
+    char item[32];
+    int i, steps = 0;
+
+    timeout_start(n, &seed);
+
+    start = bench_now_ns();
+    while (steps < CANCEL_STEPS) {
+        for (i = 0; i < n; i++) {
+            ids[i] = cupkee_timeout_register(100, 0, timeout_handle, NULL)->id;
+        }
+        for (i = 0; i < n; i++) {
+            cupkee_timeout_clear_with_id(ids[i]);
+        }
+        steps += n;
+    }
+    cost = bench_now_ns() - start;
+
+    snprintf(item, sizeof(item), "%4d timeouts, cancel id", n);
+    bench_report("timeout", item, (double)cost / steps, "ns");
+
+    cupkee_timeout_clear_all();
+}
+
+void bench_timeout(void)
+{
+    int n;
+
+    printf("Bench: timeout\n");
+
+    hw_mock_init(HEAP_SIZE);
+    cupkee_memory_setup();
+
+    for (n = 1; n <= TIMEOUT_MAX; n *= 10) {
+        timeout_ticks(n);
+    }
+    for (n = 1; n <= TIMEOUT_MAX; n *= 10) {
+        timeout_cancel(n);
+    }
+    for (n = 1; n <= TIMEOUT_MAX; n *= 10) {
+        timeout_cancel_id(n);
+    }
+
+    hw_mock_deinit();
+}
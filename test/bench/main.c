@@ -0,0 +1,74 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench.h"
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void bench_report(const char *name, const char *item, double value, const char *unit)
+{
+    printf("  %-16s %-28s %12.2f %s\n", name, item, value, unit);
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *which = argc > 1 ? argv[1] : NULL;
+
+    /***********************************************
+     * Benchmarks register here:
+     ***********************************************/
+    if (!which || !strcmp(which, "memory")) {
+        bench_memory();
+    }
+    if (!which || !strcmp(which, "object")) {
+        bench_object();
+    }
+    if (!which || !strcmp(which, "event")) {
+        bench_event();
+    }
+    if (!which || !strcmp(which, "timeout")) {
+        bench_timeout();
+    }
+    if (!which || !strcmp(which, "stream")) {
+        bench_stream();
+    }
+
+    // Replay trace on demand: bench replay <trace file> [heap size]
+    if (which && !strcmp(which, "replay")) {
+        if (argc < 3) {
+            printf("Usage: %s replay <trace file> [heap size]\n", argv[0]);
+            return 1;
+        }
+        bench_replay(argv[2], argc > 3 ? strtoul(argv[3], NULL, 0) : 0);
+    }
+
+    return 0;
+}
@@ -17,6 +17,9 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  **/
 
+#include <pthread.h>
+#include <time.h>
+
 #include "test.h"
 
 #define FLASH_SIZE  (1024 * 256)
@@ -31,21 +34,39 @@ static int mock_timer_curr_id   = -1;
 static int mock_timer_curr_period = -1;
 static int mock_timer_curr_duration = -1;
 static int mock_timer_curr_state = -1;  // 0: stop, 1: start, -1: noused
+static uint32_t mock_idle_count = 0;
+static uint32_t mock_idle_until = 0;
+static uint32_t mock_hrtimer_now = 0;
+static uint32_t mock_hrtimer_at = 0;
+static int      mock_hrtimer_armed = 0;
+
+// Interrupt mask is modeled as a global lock, nested in same thread
+static pthread_mutex_t mock_critical_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int mock_critical_depth = 0;
 
 void hw_mock_init(size_t mem_size)
 {
     if (mock_memory_base) {
+        // Event queues are kept in heap
+        cupkee_event_deinit();
         free(mock_memory_base);
     }
 
     mock_memory_base = malloc(mem_size);
     mock_memory_size = mem_size;
     mock_memory_off = 0;
+
+    mock_idle_count = 0;
+    mock_idle_until = 0;
+
+    mock_hrtimer_now = 0;
+    mock_hrtimer_armed = 0;
 }
 
 void hw_mock_deinit(void)
 {
     if (mock_memory_base) {
+        cupkee_event_deinit();
         free(mock_memory_base);
         mock_memory_base = NULL;
         mock_memory_size = 0;
@@ -75,11 +96,19 @@ int hw_mock_timer_period(void)
 void hw_enter_critical(uint32_t *state)
 {
     (void) state;
+
+    if (mock_critical_depth++ == 0) {
+        pthread_mutex_lock(&mock_critical_lock);
+    }
 }
 
 void hw_exit_critical(uint32_t state)
 {
     (void) state;
+
+    if (--mock_critical_depth == 0) {
+        pthread_mutex_unlock(&mock_critical_lock);
+    }
 }
 
 void *hw_memory_alloc(size_t size, size_t align)
@@ -130,6 +159,46 @@ void hw_info_get(hw_info_t *info)
     info->rom_sz = mock_flash_size;
 }
 
+uint32_t hw_mock_idle_count(void)
+{
+    return mock_idle_count;
+}
+
+uint32_t hw_mock_idle_until(void)
+{
+    return mock_idle_until;
+}
+
+void hw_idle(uint32_t until)
+{
+    uint32_t state = 0;
+
+    hw_enter_critical(&state);
+    if (!cupkee_event_pending() && (int32_t)(until - _cupkee_systicks) > 0) {
+        mock_idle_count++;
+        mock_idle_until = until;
+
+        // Woken up by systick at the deadline
+        _cupkee_systicks = until;
+        cupkee_event_post_systick();
+    }
+    hw_exit_critical(state);
+}
+
+uint32_t hw_cycle_count(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+uint32_t hw_cycle_freq(void)
+{
+    return 1000000000;
+}
+
 void hw_cuid_get(uint8_t *cuid)
 {
     memset(cuid, 0, CUPKEE_UID_SIZE);
@@ -334,6 +403,65 @@ int hw_timer_duration_get(int inst)
     return mock_timer_curr_duration;
 }
 
+/* HRTIMER: virtual clock in us, pass by hw_mock_hrtimer_run */
+void hw_mock_hrtimer_run(uint32_t us, uint32_t latency)
+{
+    uint32_t end = mock_hrtimer_now + us;
+
+    while (mock_hrtimer_armed && (int32_t)(mock_hrtimer_at + latency - end) <= 0) {
+        uint32_t isr = mock_hrtimer_at + latency;
+
+        // Interrupt taken after latency, or the time spent by handlers
+        if ((int32_t)(isr - mock_hrtimer_now) > 0) {
+            mock_hrtimer_now = isr;
+        }
+        mock_hrtimer_armed = 0;
+        cupkee_hrtimer_expire();
+    }
+
+    if ((int32_t)(end - mock_hrtimer_now) > 0) {
+        mock_hrtimer_now = end;
+    }
+}
+
+void hw_mock_hrtimer_spend(uint32_t us)
+{
+    mock_hrtimer_now += us;
+}
+
+int hw_mock_hrtimer_armed(void)
+{
+    return mock_hrtimer_armed;
+}
+
+int hw_hrtimer_setup(void)
+{
+    return 0;
+}
+
+uint32_t hw_hrtimer_now(void)
+{
+    return mock_hrtimer_now;
+}
+
+int hw_hrtimer_alarm(uint32_t at)
+{
+    if ((int32_t)(at - mock_hrtimer_now) <= 0) {
+        mock_hrtimer_armed = 0;
+        return -CUPKEE_ETIMEOUT;
+    }
+
+    mock_hrtimer_at = at;
+    mock_hrtimer_armed = 1;
+
+    return 0;
+}
+
+void hw_hrtimer_cancel(void)
+{
+    mock_hrtimer_armed = 0;
+}
+
 int hw_device_setup(void)
 {
     return 0;
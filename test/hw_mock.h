@@ -29,11 +29,21 @@ size_t           mock_device_curr_want(void);
 int  hw_mock_device_curr_id(void);
 size_t hw_mock_device_curr_want(void);
 
+/* IDLE: systicks jump to deadline in hw_idle, as a virtual clock */
+uint32_t hw_mock_idle_count(void);
+uint32_t hw_mock_idle_until(void);
+
 /* TIMER */
 int hw_mock_timer_curr_id(void);
 int hw_mock_timer_curr_state(void);
 int hw_mock_timer_period(void);
 void hw_mock_timer_duration_set(int us);
 
+/* HRTIMER: let us pass on virtual clock, alarm interrupt taken after latency */
+void hw_mock_hrtimer_run(uint32_t us, uint32_t latency);
+/* Time spent by handler, in interrupt */
+void hw_mock_hrtimer_spend(uint32_t us);
+int  hw_mock_hrtimer_armed(void);
+
 #endif /* __HW_MOCK_INC__ */
 
@@ -35,6 +35,9 @@ int main(int argc, const char *argv[])
     test_hello();
 
     test_sys_memory();
+    test_sys_pool();
+    test_sys_arena();
+    test_sys_meter();
     test_sys_event();
 
     test_sys_timeout();
@@ -45,6 +48,7 @@ int main(int argc, const char *argv[])
     test_sys_object();
     test_sys_pin();
     test_sys_timer();
+    test_sys_hrtimer();
     test_sys_device();
 
     /***********************************************
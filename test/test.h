@@ -36,6 +36,9 @@ CU_pSuite test_hello(void);
 
 CU_pSuite test_sys_event(void);
 CU_pSuite test_sys_memory(void);
+CU_pSuite test_sys_pool(void);
+CU_pSuite test_sys_arena(void);
+CU_pSuite test_sys_meter(void);
 CU_pSuite test_sys_timeout(void);
 CU_pSuite test_sys_process(void);
 CU_pSuite test_sys_struct(void);
@@ -45,6 +48,7 @@ CU_pSuite test_sys_object(void);
 CU_pSuite test_sys_device(void);
 CU_pSuite test_sys_pin(void);
 CU_pSuite test_sys_timer(void);
+CU_pSuite test_sys_hrtimer(void);
 
 #endif /* __TEST_INC__ */
 
@@ -0,0 +1,132 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+static int test_setup(void)
+{
+    return TU_pre_init();
+}
+
+static int test_clean(void)
+{
+    return TU_pre_deinit();
+}
+
+static int free_pages(void)
+{
+    int order, n = 0;
+
+    for (order = 0; order < CUPKEE_PAGE_ORDERR_MAX; order++) {
+        n += cupkee_free_pages(order) << order;
+    }
+
+    return n;
+}
+
+static uint32_t bytes_used(void)
+{
+    cupkee_memory_stat_t stat;
+
+    cupkee_memory_stats(&stat);
+    return stat.bytes_used;
+}
+
+static void test_arena_alloc(void)
+{
+    cupkee_arena_t arena;
+    uint8_t *a, *b, *c;
+    int pages = free_pages();
+    uint32_t used = bytes_used();
+
+    cupkee_arena_init(&arena);
+    CU_ASSERT(NULL == cupkee_arena_alloc(&arena, 0));
+    CU_ASSERT(pages == free_pages());
+
+    // Bump in one page
+    CU_ASSERT(NULL != (a = cupkee_arena_alloc(&arena, 10)));
+    CU_ASSERT(NULL != (b = cupkee_arena_alloc(&arena, 100)));
+    CU_ASSERT(b == a + CUPKEE_SIZE_ALIGN(10, sizeof(intptr_t)));
+    CU_ASSERT(pages == free_pages() + 1);
+
+    // New page, when current one is not enough
+    CU_ASSERT(NULL != (c = cupkee_arena_alloc(&arena, CUPKEE_PAGE_SIZE - 16)));
+    CU_ASSERT(pages == free_pages() + 2);
+    CU_ASSERT(NULL != cupkee_arena_alloc(&arena, CUPKEE_PAGE_SIZE + 1));
+    CU_ASSERT(pages == free_pages() + 4);
+    CU_ASSERT(used + 4 * CUPKEE_PAGE_SIZE == bytes_used());
+    CU_ASSERT(NULL == cupkee_arena_alloc(&arena, CUPKEE_PAGE_SIZE << CUPKEE_PAGE_ORDERR_MAX));
+
+    // Reset keep the first page
+    cupkee_arena_reset(&arena);
+    CU_ASSERT(pages == free_pages() + 1);
+    CU_ASSERT(a == cupkee_arena_alloc(&arena, 8));
+
+    cupkee_arena_release(&arena);
+    CU_ASSERT(pages == free_pages());
+    CU_ASSERT(used == bytes_used());
+    cupkee_arena_reset(&arena);
+    cupkee_arena_release(&arena);
+    CU_ASSERT(pages == free_pages());
+}
+
+static void test_arena_mark(void)
+{
+    cupkee_arena_t arena;
+    cupkee_arena_mark_t outer, inner;
+    uint8_t *a, *b;
+    int pages = free_pages();
+
+    cupkee_arena_init(&arena);
+
+    // Mark of empty arena
+    cupkee_arena_mark(&arena, &outer);
+    CU_ASSERT(NULL != (a = cupkee_arena_alloc(&arena, 64)));
+
+    cupkee_arena_mark(&arena, &inner);
+    CU_ASSERT(NULL != (b = cupkee_arena_alloc(&arena, 64)));
+    CU_ASSERT(NULL != cupkee_arena_alloc(&arena, CUPKEE_PAGE_SIZE));
+    CU_ASSERT(pages == free_pages() + 2);
+
+    cupkee_arena_rewind(&arena, &inner);
+    CU_ASSERT(pages == free_pages() + 1);
+    CU_ASSERT(b == cupkee_arena_alloc(&arena, 64));
+
+    cupkee_arena_rewind(&arena, &outer);
+    CU_ASSERT(pages == free_pages());
+    CU_ASSERT(NULL != cupkee_arena_alloc(&arena, 64));
+
+    cupkee_arena_release(&arena);
+    CU_ASSERT(pages == free_pages());
+}
+
+CU_pSuite test_sys_arena(void)
+{
+    CU_pSuite suite = CU_add_suite("system arena", test_setup, test_clean);
+
+    if (suite) {
+        CU_add_test(suite, "arena alloc      ", test_arena_alloc);
+        CU_add_test(suite, "arena mark       ", test_arena_mark);
+    }
+
+    return suite;
+}
@@ -230,11 +230,46 @@ static const cupkee_device_desc_t mock_device = {
     .driver = &mock_driver
 };
 
+static const cupkee_struct_desc_t mock_buf_conf_desc[] = {
+    {
+        .name = "rxbuffer",
+        .type = CUPKEE_STRUCT_UINT16
+    },
+};
+
+static cupkee_struct_t *mock_buf_conf_init(void *curr)
+{
+    cupkee_struct_t *conf;
+
+    if (curr) {
+        conf = curr;
+        cupkee_struct_reset(conf);
+    } else {
+        conf = cupkee_struct_alloc(1, mock_buf_conf_desc);
+    }
+
+    if (conf) {
+        cupkee_struct_set_uint(conf, 0, 0);
+    }
+
+    return conf;
+}
+
+static const cupkee_device_desc_t mock_buf_device = {
+    .name = "mockbuf",
+    .inst_max = 1,
+    .conf_init = mock_buf_conf_init,
+    .driver = &mock_driver,
+    .rx_size = 64,
+    .tx_size = 16
+};
+
 static int test_setup(void)
 {
     TU_pre_init();
 
     cupkee_device_register(&mock_device);
+    cupkee_device_register(&mock_buf_device);
 
     return 0;
 }
@@ -552,6 +587,128 @@ static void test_config(void)
     cupkee_release(dev);
 }
 
+static int sensor_value;
+static int sensor_state;
+
+static void sensor_finish(int state, intptr_t data)
+{
+    (void) data;
+    sensor_state = state;
+}
+
+/* Driver of two transactions, as straight line steps */
+static void sensor_task(void *entry)
+{
+    void *d = (void *)cupkee_process_data(entry);
+    uint8_t *res;
+
+    if (cupkee_process_step(entry) > 0) {
+        if (cupkee_process_woken(entry) != CUPKEE_EVENT_RESPONSE
+            || 2 != cupkee_device_response_take(d, (void **)&res)) {
+            cupkee_process_fail(entry, -CUPKEE_ETIMEOUT);
+            return;
+        }
+        sensor_value = (sensor_value << 16) | (res[0] << 8) | res[1];
+        cupkee_free(res);
+    }
+
+    switch (cupkee_process_step(entry)) {
+    case 0:
+        cupkee_device_query(d, 1, "A", 2, NULL, 0);
+        cupkee_process_wait_response(entry, d);
+        cupkee_process_wait_timeout(entry, 100);
+        break;
+    case 1:
+        cupkee_device_query(d, 1, "B", 2, NULL, 0);
+        cupkee_process_wait_response(entry, d);
+        break;
+    default:
+        cupkee_process_done(entry);
+    }
+}
+
+static void test_wait_response(void)
+{
+    void *d;
+
+    CU_ASSERT_FATAL(NULL != (d = cupkee_device_request("mock", 0)));
+    CU_ASSERT(0 == cupkee_device_enable(d));
+    CU_ASSERT(0 == cupkee_device_is_busy(d));
+
+    sensor_value = 0;
+    sensor_state = -1;
+    CU_ASSERT(0 == cupkee_process_start(sensor_task, (intptr_t)d, sensor_finish));
+    CU_ASSERT(1 == cupkee_device_is_busy(d));
+    CU_ASSERT(!cupkee_process_pending());
+
+    // Bsp driver reply
+    CU_ASSERT(2 == cupkee_device_response_push(d, 2, "\x12\x34"));
+    cupkee_device_response_end(d);
+    cupkee_event_poll();
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
+    CU_ASSERT(sensor_value == 0x1234);
+    CU_ASSERT(1 == cupkee_device_is_busy(d));
+
+    CU_ASSERT(2 == cupkee_device_response_push(d, 2, "\x56\x78"));
+    cupkee_device_response_end(d);
+    cupkee_event_poll();
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
+    CU_ASSERT(sensor_value == 0x12345678);
+    CU_ASSERT(sensor_state == CUPKEE_OK);
+
+    CU_ASSERT(0 == cupkee_device_disable(d));
+    cupkee_release(d);
+    cupkee_event_poll();
+}
+
+static void test_buffer_size(void)
+{
+    cupkee_device_t *d;
+    uint8_t buf[64];
+
+    // Default size
+    CU_ASSERT_FATAL(NULL != (d = cupkee_device_request("mock", 0)));
+    CU_ASSERT(0 == cupkee_device_enable(d));
+    CU_ASSERT(d->s->rx_buf_size == CUPKEE_DEVICE_STREAM_SIZE);
+    CU_ASSERT(d->s->tx_buf_size == CUPKEE_DEVICE_STREAM_SIZE);
+    cupkee_release(d);
+
+    // Size of descriptor
+    CU_ASSERT_FATAL(NULL != (d = cupkee_device_request("mockbuf", 0)));
+    CU_ASSERT(0 == cupkee_device_enable(d));
+    CU_ASSERT(d->s->rx_buf_size == 64 && d->s->tx_buf_size == 16);
+    CU_ASSERT(16 == cupkee_write(d, 64, buf));
+
+    // Size of config
+    CU_ASSERT(0 == cupkee_device_disable(d));
+    CU_ASSERT(0 < cupkee_struct_set_uint2(cupkee_device_config(d), "rxbuffer", 256));
+    CU_ASSERT(0 == cupkee_device_enable(d));
+    CU_ASSERT(d->s->rx_buf_size == 256 && d->s->tx_buf_size == 16);
+
+    // Grow at runtime, while idle
+    CU_ASSERT(1 == cupkee_device_push(d, 1, buf));
+    CU_ASSERT(-CUPKEE_EBUSY == cupkee_device_stream_resize(d, 512, 0));
+    CU_ASSERT(d->s->rx_buf_size == 256);
+    // Rx busy, idle tx is not grown either
+    CU_ASSERT(-CUPKEE_EBUSY == cupkee_device_stream_resize(d, 512, 64));
+    CU_ASSERT(d->s->rx_buf_size == 256 && d->s->tx_buf_size == 16);
+    // Buffer kept is not checked
+    CU_ASSERT(0 == cupkee_device_stream_resize(d, 0, 32));
+    CU_ASSERT(d->s->rx_buf_size == 256 && d->s->tx_buf_size == 32);
+    CU_ASSERT(1 == cupkee_read(d, 1, buf));
+    CU_ASSERT(0 == cupkee_device_stream_resize(d, 512, 64));
+    CU_ASSERT(d->s->rx_buf_size == 512 && d->s->tx_buf_size == 64);
+    CU_ASSERT(0 == cupkee_device_stream_resize(d, 128, 0));
+    CU_ASSERT(d->s->rx_buf_size == 512);
+    CU_ASSERT(-CUPKEE_EINVAL == cupkee_device_stream_resize(d, CUPKEE_DEVICE_STREAM_SIZE_MAX + 1, 0));
+
+    CU_ASSERT(64 == cupkee_write(d, 64, buf));
+    CU_ASSERT(64 == cupkee_device_pull(d, 64, buf));
+
+    cupkee_release(d);
+    cupkee_event_poll();
+}
+
 CU_pSuite test_sys_device(void)
 {
     CU_pSuite suite = CU_add_suite("system device", test_setup, test_clean);
@@ -561,12 +718,14 @@ CU_pSuite test_sys_device(void)
         CU_add_test(suite, "device enable    ", test_enable);
 
         CU_add_test(suite, "device query     ", test_query);
+        CU_add_test(suite, "device wait resp ", test_wait_response);
         CU_add_test(suite, "device read      ", test_read);
         CU_add_test(suite, "device write     ", test_write);
 
         CU_add_test(suite, "device event     ", test_event);
 
         CU_add_test(suite, "device config    ", test_config);
+        CU_add_test(suite, "device buf size  ", test_buffer_size);
     }
 
     return suite;
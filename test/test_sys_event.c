@@ -19,6 +19,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 #include "test.h"
 #include <cupkee.h>
@@ -42,7 +45,8 @@ static void test_post_take(void)
     int i;
     cupkee_event_t e;
 
-    cupkee_event_setup();
+    CU_ASSERT(0 > cupkee_event_setup(0, 0, 0));
+    CU_ASSERT(0 == cupkee_event_setup(16, 0, 0));
 
     CU_ASSERT_EQUAL(cupkee_event_post(0, 0, 0), 1);
     CU_ASSERT_EQUAL(cupkee_event_take(&e), 1);
@@ -67,6 +71,416 @@ static void test_post_take(void)
     cupkee_event_reset();
 }
 
+static void test_setup_again(void)
+{
+    cupkee_memory_stat_t stat;
+    uint32_t used;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 8, 0));
+    cupkee_memory_stats(&stat);
+    used = stat.bytes_used;
+
+    // Queues of last setup are released
+    CU_ASSERT(0 == cupkee_event_setup(16, 8, 0));
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(stat.bytes_used == used);
+
+    // Low queue is released, if the high one fail
+    CU_ASSERT(0 > cupkee_event_setup(16, 0x10000, 0));
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(stat.bytes_used < used);
+    CU_ASSERT(0 == cupkee_event_post(1, 2, 3));
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 8, 0));
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(stat.bytes_used == used);
+    cupkee_event_reset();
+}
+
+static void test_take_batch(void)
+{
+    cupkee_event_t batch[8];
+    int i, n;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 0, CUPKEE_EVENTQ_COALESCE_SYSTICK));
+
+    CU_ASSERT(0 == cupkee_event_take_batch(batch, 8));
+
+    for (i = 0; i < 12; i++) {
+        CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, i, i + 100));
+    }
+
+    // In order, not more than max
+    CU_ASSERT(8 == cupkee_event_take_batch(batch, 8));
+    for (i = 0; i < 8; i++) {
+        CU_ASSERT(batch[i].type == EVENT_OBJECT && batch[i].code == i && batch[i].which == i + 100);
+    }
+
+    // Ring wrap around
+    for (i = 12; i < 20; i++) {
+        CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, i, i + 100));
+    }
+    CU_ASSERT(1 == cupkee_event_post_systick());
+    CU_ASSERT(8 == cupkee_event_take_batch(batch, 8));
+    CU_ASSERT(batch[0].code == 8 && batch[7].code == 15);
+    n = cupkee_event_take_batch(batch, 8);
+    CU_ASSERT(n == 5);
+    CU_ASSERT(batch[0].code == 16 && batch[3].code == 19);
+    CU_ASSERT(batch[4].type == EVENT_SYSTICK);
+
+    // Systick taken in batch is not pending anymore
+    CU_ASSERT(1 == cupkee_event_post_systick());
+    CU_ASSERT(1 == cupkee_event_take_batch(batch, 8));
+
+    cupkee_event_reset();
+}
+
+static void test_overflow(void)
+{
+    int i;
+    cupkee_event_t e;
+    cupkee_event_stat_t stat;
+
+    CU_ASSERT(0 == cupkee_event_setup(4, 0, 0));
+
+    for (i = 0; i < 4; i++) {
+        CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 1, i));
+    }
+    CU_ASSERT(0 == cupkee_event_post(EVENT_OBJECT, 1, 4));
+    CU_ASSERT(0 == cupkee_event_post(EVENT_PIN, 1, 0));
+    CU_ASSERT(0 == cupkee_event_post(EVENT_PIN, 1, 1));
+
+    cupkee_event_stats(&stat);
+    CU_ASSERT(stat.depth == 4);
+    CU_ASSERT(stat.peak == 4);
+    CU_ASSERT(stat.dropped[EVENT_SYSTICK] == 0);
+    CU_ASSERT(stat.dropped[EVENT_OBJECT] == 1);
+    CU_ASSERT(stat.dropped[EVENT_PIN] == 2);
+
+    for (i = 0; i < 4; i++) {
+        CU_ASSERT(1 == cupkee_event_take(&e));
+        CU_ASSERT(e.which == i);
+    }
+    CU_ASSERT(0 == cupkee_event_take(&e));
+
+    cupkee_event_reset();
+}
+
+static void test_coalesce(void)
+{
+    cupkee_event_t e;
+    cupkee_event_stat_t stat;
+
+    CU_ASSERT(0 == cupkee_event_setup(4, 0, CUPKEE_EVENTQ_COALESCE_SYSTICK));
+    CU_ASSERT(1 == cupkee_event_post_systick());
+    CU_ASSERT(1 == cupkee_event_post_systick());
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 1, 1));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 1, 1));
+    CU_ASSERT(1 == cupkee_event_take(&e) && e.type == EVENT_SYSTICK);
+    CU_ASSERT(1 == cupkee_event_take(&e) && e.type == EVENT_OBJECT);
+    CU_ASSERT(1 == cupkee_event_take(&e) && e.type == EVENT_OBJECT);
+    CU_ASSERT(0 == cupkee_event_take(&e));
+
+    // Systick is queued again, after the pending one is taken
+    CU_ASSERT(1 == cupkee_event_post_systick());
+    CU_ASSERT(1 == cupkee_event_take(&e) && e.type == EVENT_SYSTICK);
+
+    CU_ASSERT(0 == cupkee_event_setup(4, 0, CUPKEE_EVENTQ_COALESCE_SYSTICK | CUPKEE_EVENTQ_COALESCE_SAME));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 1, 1));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 1, 1));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 2, 1));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, 1, 2));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_PIN, 1, 1));
+    CU_ASSERT(1 == cupkee_event_post(EVENT_PIN, 1, 1));
+    CU_ASSERT(0 == cupkee_event_post(EVENT_PIN, 2, 1));
+
+    cupkee_event_stats(&stat);
+    CU_ASSERT(stat.coalesced == 2);
+    CU_ASSERT(stat.dropped[EVENT_PIN] == 1);
+
+    cupkee_event_reset();
+}
+
+#define STRESS_PERIODS      (1000)
+#define STRESS_LOOP_MS      (10)
+#define STRESS_UART_DATA    (8)     // DATA events per ms
+#define STRESS_PINS         (4)
+
+/* Main loop is busy for STRESS_LOOP_MS between polls, meanwhile
+ * 1 kHz systick, UART DATA & DRAIN and pin edges keep coming.
+ * Every distinct event should be seen in the next poll.
+ */
+static void test_stress(void)
+{
+    int period, ms, i;
+    cupkee_event_t e;
+    cupkee_event_stat_t stat;
+    uint32_t lost = 0;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 0, CUPKEE_EVENTQ_COALESCE_SYSTICK | CUPKEE_EVENTQ_COALESCE_SAME));
+
+    for (period = 0; period < STRESS_PERIODS; period++) {
+        uint32_t seen = 0, want = 0;
+
+        for (ms = 0; ms < STRESS_LOOP_MS; ms++) {
+            cupkee_event_post_systick();
+            want |= 1;
+
+            for (i = 0; i < STRESS_UART_DATA; i++) {
+                cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DATA, 1);
+            }
+            want |= 2;
+            if (ms & 1) {
+                cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DRAIN, 1);
+                want |= 4;
+            }
+
+            i = (period + ms) % STRESS_PINS;
+            cupkee_event_post_pin(i, (ms & 2) ? CUPKEE_EVENT_PIN_RISING : CUPKEE_EVENT_PIN_FALLING);
+            want |= 1 << (8 + i * 2 + ((ms & 2) ? 0 : 1));
+        }
+
+        while (cupkee_event_take(&e)) {
+            if (e.type == EVENT_SYSTICK) {
+                seen |= 1;
+            } else
+            if (e.type == EVENT_OBJECT) {
+                seen |= e.code == CUPKEE_EVENT_DATA ? 2 : 4;
+            } else {
+                seen |= 1 << (8 + e.which * 2 + (e.code == CUPKEE_EVENT_PIN_RISING ? 0 : 1));
+            }
+        }
+        if (seen != want) {
+            lost++;
+        }
+    }
+
+    cupkee_event_stats(&stat);
+    CU_ASSERT(lost == 0);
+    CU_ASSERT(stat.dropped[EVENT_SYSTICK] == 0);
+    CU_ASSERT(stat.dropped[EVENT_OBJECT] == 0);
+    CU_ASSERT(stat.dropped[EVENT_PIN] == 0);
+    CU_ASSERT(stat.peak <= 16);
+
+    cupkee_event_reset();
+}
+
+#define LATENCY_DISPATCH    (4000)
+#define LATENCY_HIGH_EVERY  (5)
+
+/* Main loop take events in batch of 8, each low event handled post two
+ * more to keep low queue saturated, pin edge come every 5 dispatches.
+ * Return max dispatches between pin edge post and it handled.
+ */
+static int latency_run(int high_depth, cupkee_event_stat_t *stat)
+{
+    cupkee_event_t batch[8];
+    int posted_at[16];
+    int dispatched = 0, max_delay = 0, seq = 0;
+    int i, n;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, high_depth, 0));
+    for (i = 0; i < 16; i++) {
+        cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DATA, i);
+    }
+
+    while (dispatched < LATENCY_DISPATCH) {
+        n = cupkee_event_take_batch(batch, 8);
+        CU_ASSERT(n > 0);
+        if (n <= 0) {
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            cupkee_event_t *e = &batch[i];
+
+            dispatched++;
+            if (e->type == EVENT_PIN) {
+                int delay = dispatched - posted_at[e->which % 16];
+                if (delay > max_delay) {
+                    max_delay = delay;
+                }
+            } else {
+                cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DATA, e->which);
+                cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DRAIN, e->which);
+            }
+
+            if (dispatched % LATENCY_HIGH_EVERY == 0) {
+                posted_at[seq % 16] = dispatched;
+                cupkee_event_post_pin(seq % 16, CUPKEE_EVENT_PIN_RISING);
+                seq++;
+            }
+        }
+    }
+
+    cupkee_event_stats(stat);
+    cupkee_event_reset();
+
+    return max_delay;
+}
+
+static void test_priority(void)
+{
+    cupkee_event_stat_t stat;
+    int delay;
+
+    // Single FIFO, pin edge wait behind the saturated queue or get lost
+    delay = latency_run(0, &stat);
+    CU_ASSERT(stat.dropped[EVENT_OBJECT] > 0);
+    CU_ASSERT(delay > 16 || stat.dropped[EVENT_PIN] > 0);
+
+    // Pin edge is handled in next batch, never lost
+    delay = latency_run(8, &stat);
+    CU_ASSERT(stat.dropped[EVENT_OBJECT] > 0);
+    CU_ASSERT(stat.dropped[EVENT_PIN] == 0);
+    CU_ASSERT(delay <= 8);
+}
+
+static void test_starvation(void)
+{
+    cupkee_event_t batch[8];
+    int dispatched = 0, last_low = 0, max_gap = 0, low = 0;
+    int i, n;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 8, 0));
+    for (i = 0; i < 4; i++) {
+        cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DATA, i);
+    }
+    for (i = 0; i < 8; i++) {
+        cupkee_event_post_pin(i, CUPKEE_EVENT_PIN_RISING);
+    }
+
+    // Each pin edge handled post two more, high queue never empty
+    while (low < 4 && dispatched < 1000) {
+        n = cupkee_event_take_batch(batch, 8);
+        for (i = 0; i < n; i++) {
+            dispatched++;
+            if (batch[i].type == EVENT_PIN) {
+                cupkee_event_post_pin(batch[i].which, CUPKEE_EVENT_PIN_RISING);
+                cupkee_event_post_pin(batch[i].which, CUPKEE_EVENT_PIN_FALLING);
+            } else {
+                if (dispatched - last_low > max_gap) {
+                    max_gap = dispatched - last_low;
+                }
+                last_low = dispatched;
+                low++;
+            }
+        }
+    }
+
+    CU_ASSERT(low == 4);
+    CU_ASSERT(max_gap <= CUPKEE_EVENTQ_HIGH_BURST + 8);
+
+    cupkee_event_reset();
+}
+
+#if CUPKEE_EVENT_TRACE
+static void test_trace(void)
+{
+    cupkee_event_t batch[4];
+    cupkee_event_trace_t rec[4];
+    cupkee_event_delay_t delay;
+    struct timespec ts = {0, 2000000};
+    int i, n;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 4, 0));
+    CU_ASSERT(0 == cupkee_event_trace_read(rec, 4));
+
+    CU_ASSERT(1 == cupkee_event_post(EVENT_OBJECT, CUPKEE_EVENT_DATA, 7));
+    CU_ASSERT(1 == cupkee_event_post_pin(3, CUPKEE_EVENT_PIN_RISING));
+    nanosleep(&ts, NULL);
+
+    n = cupkee_event_take_batch(batch, 4);
+    CU_ASSERT(n == 2);
+    for (i = 0; i < n; i++) {
+        cupkee_event_trace_dispatch(i, &batch[i]);
+    }
+
+    // Pin edge first, both waited about 2ms
+    CU_ASSERT(2 == cupkee_event_trace_read(rec, 4));
+    CU_ASSERT(rec[0].type == EVENT_PIN && rec[0].which == 3);
+    CU_ASSERT(rec[1].type == EVENT_OBJECT && rec[1].code == CUPKEE_EVENT_DATA && rec[1].which == 7);
+    CU_ASSERT(rec[1].dispatch - rec[1].post >= 2000000);
+
+    CU_ASSERT(0 == cupkee_event_delay_get(EVENT_OBJECT, &delay));
+    CU_ASSERT(delay.count == 1);
+    CU_ASSERT(delay.min >= 2000 && delay.min == delay.max && delay.avg == delay.min);
+    CU_ASSERT(delay.hist[CUPKEE_EVENT_TRACE_HIST - 1] == 1);
+    CU_ASSERT(0 == cupkee_event_delay_get(EVENT_SYSTICK, &delay));
+    CU_ASSERT(delay.count == 0);
+    CU_ASSERT(0 > cupkee_event_delay_get(EVENT_TYPE_MAX, &delay));
+
+    // Oldest records dropped
+    for (i = 0; i < CUPKEE_EVENT_TRACE_SIZE + 2; i++) {
+        cupkee_event_post_systick();
+        CU_ASSERT(1 == cupkee_event_take_batch(batch, 4));
+        cupkee_event_trace_dispatch(0, &batch[0]);
+    }
+    CU_ASSERT(cupkee_event_trace_lost() == 2);
+    CU_ASSERT(0 == cupkee_event_delay_get(EVENT_SYSTICK, &delay));
+    CU_ASSERT(delay.count == CUPKEE_EVENT_TRACE_SIZE + 2);
+    CU_ASSERT(delay.max < 2000);
+
+    cupkee_event_reset();
+}
+#endif
+
+#define CONCURRENT_PRODUCERS    (3)
+#define CONCURRENT_EVENTS       (20000)
+
+/* Each producer plays an interrupt, post events of its own with sequence
+ * in code, retry while queue is full.
+ */
+static void *concurrent_producer(void *arg)
+{
+    uint16_t which = (uintptr_t)arg;
+    int i;
+
+    for (i = 0; i < CONCURRENT_EVENTS; i++) {
+        while (!cupkee_event_post(EVENT_OBJECT, (uint8_t)i, which)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent(void)
+{
+    pthread_t producers[CONCURRENT_PRODUCERS];
+    uint8_t next[CONCURRENT_PRODUCERS];
+    int i, taken = 0, disorder = 0;
+    cupkee_event_t e;
+
+    CU_ASSERT(0 == cupkee_event_setup(16, 0, 0));
+
+    memset(next, 0, sizeof(next));
+    for (i = 0; i < CONCURRENT_PRODUCERS; i++) {
+        CU_ASSERT(0 == pthread_create(&producers[i], NULL, concurrent_producer, (void *)(uintptr_t)i));
+    }
+
+    while (taken < CONCURRENT_PRODUCERS * CONCURRENT_EVENTS) {
+        if (!cupkee_event_take(&e)) {
+            sched_yield();
+            continue;
+        }
+        if (e.type != EVENT_OBJECT || e.which >= CONCURRENT_PRODUCERS || e.code != next[e.which]) {
+            disorder++;
+        } else {
+            next[e.which]++;
+        }
+        taken++;
+    }
+
+    for (i = 0; i < CONCURRENT_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+
+    CU_ASSERT(disorder == 0);
+    CU_ASSERT(0 == cupkee_event_take(&e));
+
+    cupkee_event_reset();
+}
+
 #if 0
 static uint8_t emitter1_storage;
 static uint8_t emitter2_storage;
@@ -87,7 +501,7 @@ static void test_emitter(void)
 
     emitter1_storage = 0;
     emitter2_storage = 0;
-    cupkee_event_setup();
+    cupkee_event_setup(16, 0, 0);
 
     CU_ASSERT(cupkee_event_emitter_init(&emitter1, emitter1_event_handle) >= 0);
     CU_ASSERT(cupkee_event_emitter_init(&emitter2, emitter2_event_handle) >= 0);
@@ -116,7 +530,7 @@ static void test_emitter_emit(void)
 
     emitter1_storage = 0;
     emitter2_storage = 0;
-    cupkee_event_setup();
+    cupkee_event_setup(16, 0, 0);
 
     CU_ASSERT(cupkee_event_emitter_init(&emitter1, emitter1_event_handle) >= 0);
     CU_ASSERT(cupkee_event_emitter_init(&emitter2, emitter2_event_handle) >= 0);
@@ -149,6 +563,17 @@ CU_pSuite test_sys_event(void)
 
     if (suite) {
         CU_add_test(suite, "post & take      ", test_post_take);
+        CU_add_test(suite, "setup again      ", test_setup_again);
+        CU_add_test(suite, "take batch       ", test_take_batch);
+        CU_add_test(suite, "overflow         ", test_overflow);
+        CU_add_test(suite, "coalesce         ", test_coalesce);
+        CU_add_test(suite, "stress           ", test_stress);
+        CU_add_test(suite, "concurrent       ", test_concurrent);
+        CU_add_test(suite, "priority         ", test_priority);
+        CU_add_test(suite, "starvation       ", test_starvation);
+#if CUPKEE_EVENT_TRACE
+        CU_add_test(suite, "trace            ", test_trace);
+#endif
 //        CU_add_test(suite, "emitter          ", test_emitter);
 //        CU_add_test(suite, "emitter emit     ", test_emitter_emit);
     }
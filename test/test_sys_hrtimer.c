@@ -0,0 +1,186 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include <cupkee.h>
+
+#define CLIENT_MAX      24
+
+typedef struct client_t {
+    cupkee_hrtimer_t timer;
+    uint32_t deadline;      // expected
+    uint32_t period;
+    uint32_t fired;
+} client_t;
+
+static client_t clients[CLIENT_MAX];
+static uint32_t last_deadline;
+static uint32_t late_max;
+static uint32_t spend;
+static int disorder, early;
+
+static int test_setup(void)
+{
+    return TU_pre_init();
+}
+
+static int test_clean(void)
+{
+    return TU_pre_deinit();
+}
+
+static void client_reset(void)
+{
+    memset(clients, 0, sizeof(clients));
+    last_deadline = cupkee_hrtimer_now();
+    late_max = 0;
+    spend = 0;
+    disorder = 0;
+    early = 0;
+}
+
+static void client_handle(cupkee_hrtimer_t *t, void *param)
+{
+    client_t *c = param;
+    uint32_t now = cupkee_hrtimer_now();
+
+    (void) t;
+
+    if ((int32_t)(c->deadline - last_deadline) < 0) {
+        disorder++;
+    }
+    if ((int32_t)(now - c->deadline) < 0) {
+        early++;
+    } else
+    if (now - c->deadline > late_max) {
+        late_max = now - c->deadline;
+    }
+
+    last_deadline = c->deadline;
+    c->deadline += c->period;
+    c->fired++;
+
+    hw_mock_hrtimer_spend(spend);
+}
+
+static void client_start(client_t *c, uint32_t us, uint32_t period)
+{
+    cupkee_hrtimer_init(&c->timer, client_handle, c);
+
+    c->deadline = cupkee_hrtimer_now() + us;
+    c->period = period;
+    CU_ASSERT(0 == cupkee_hrtimer_start(&c->timer, us, period));
+}
+
+static void test_oneshot(void)
+{
+    client_reset();
+
+    CU_ASSERT(0 != cupkee_hrtimer_start(NULL, 10, 0));
+
+    // Started in reverse order, fire in order of deadline
+    client_start(&clients[0], 300, 0);
+    client_start(&clients[1], 200, 0);
+    client_start(&clients[2], 100, 0);
+    CU_ASSERT(hw_mock_hrtimer_armed());
+
+    hw_mock_hrtimer_run(150, 0);
+    CU_ASSERT(clients[2].fired == 1 && clients[1].fired == 0 && clients[0].fired == 0);
+
+    // Stop the head, alarm move to the next
+    CU_ASSERT(0 == cupkee_hrtimer_stop(&clients[1].timer));
+    CU_ASSERT(!cupkee_hrtimer_is_active(&clients[1].timer));
+    hw_mock_hrtimer_run(200, 0);
+    CU_ASSERT(clients[1].fired == 0 && clients[0].fired == 1);
+    CU_ASSERT(!hw_mock_hrtimer_armed());
+
+    CU_ASSERT(disorder == 0 && early == 0 && late_max == 0);
+}
+
+static void test_periodic(void)
+{
+    int i;
+
+    client_reset();
+
+    // Dozens of periodic clients, period 50us ~ 349us
+    for (i = 0; i < CLIENT_MAX; i++) {
+        uint32_t period = 50 + i * 13;
+
+        client_start(&clients[i], period, period);
+    }
+
+    hw_mock_hrtimer_run(100000, 3);
+    for (i = 0; i < CLIENT_MAX; i++) {
+        uint32_t period = 50 + i * 13;
+
+        // Last alarm may still wait the latency
+        CU_ASSERT(clients[i].fired >= 100000 / period - 1 && clients[i].fired <= 100000 / period);
+    }
+    CU_ASSERT(disorder == 0 && early == 0);
+    CU_ASSERT(late_max == 3);
+
+    for (i = 0; i < CLIENT_MAX; i++) {
+        CU_ASSERT(0 == cupkee_hrtimer_stop(&clients[i].timer));
+    }
+    CU_ASSERT(!hw_mock_hrtimer_armed());
+}
+
+static void test_jitter(void)
+{
+    int i;
+
+    client_reset();
+
+    // Handler spend 2us each, jitter come from clients with near deadline
+    spend = 2;
+    for (i = 0; i < CLIENT_MAX; i++) {
+        uint32_t period = 500 + i;
+
+        client_start(&clients[i], period, period);
+    }
+
+    hw_mock_hrtimer_run(50000, 1);
+    for (i = 0; i < CLIENT_MAX; i++) {
+        CU_ASSERT(clients[i].fired >= 50000u / (500 + i) - 1);
+    }
+    CU_ASSERT(disorder == 0 && early == 0);
+    CU_ASSERT(late_max > 1 && late_max <= 1 + spend * CLIENT_MAX);
+
+    for (i = 0; i < CLIENT_MAX; i++) {
+        cupkee_hrtimer_stop(&clients[i].timer);
+    }
+}
+
+CU_pSuite test_sys_hrtimer(void)
+{
+    CU_pSuite suite = CU_add_suite("system hrtimer", test_setup, test_clean);
+
+    if (suite) {
+        CU_add_test(suite, "hrtimer oneshot   ", test_oneshot);
+        CU_add_test(suite, "hrtimer periodic  ", test_periodic);
+        CU_add_test(suite, "hrtimer jitter    ", test_jitter);
+    }
+
+    return suite;
+}
+
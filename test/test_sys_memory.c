@@ -132,6 +132,8 @@ static void test_memory_alloc(void)
     hw_mock_init(16 * 1024 + 1023);
 
     CU_ASSERT(0 == cupkee_memory_setup());
+    // Pages return to buddy system at once
+    CU_ASSERT(0 == cupkee_memory_cache_set(0, 0));
 
     // Where are 15 Pages can be use
     CU_ASSERT(1 == cupkee_free_pages(0));
@@ -281,6 +283,450 @@ static void test_memory_alloc(void)
     hw_mock_deinit();
 }
 
+static int memory_free_pages(void)
+{
+    int order, n = 0;
+
+    for (order = 0; order < CUPKEE_PAGE_ORDERR_MAX; order++) {
+        n += cupkee_free_pages(order) << order;
+    }
+
+    return n;
+}
+
+static void test_memory_partial(void)
+{
+    int i, pages;
+    void *mem[32 * 3];
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_cache_set(0, 0));
+
+    // Fill three pages with 32Bytes blocks
+    for (i = 0; i < 32 * 3; i++) {
+        if (NULL == (mem[i] = cupkee_malloc(32))) {
+            CU_ASSERT_FATAL(0);
+        }
+    }
+    pages = memory_free_pages();
+
+    // Free blocks in the oldest pages, the newest one is still full
+    cupkee_free(mem[0]);
+    cupkee_free(mem[33]);
+    cupkee_free(mem[34]);
+
+    // Free blocks should be reused, no more page required
+    for (i = 0; i < 3; i++) {
+        CU_ASSERT(NULL != cupkee_malloc(32));
+        CU_ASSERT(pages == memory_free_pages());
+    }
+
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    cupkee_free(mem[0]);
+    CU_ASSERT(pages == memory_free_pages());
+
+    hw_mock_deinit();
+}
+
+static void test_memory_class(void)
+{
+    int i, pages;
+    void *mem[64];
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_cache_set(0, 0));
+    pages = memory_free_pages();
+
+    // 33Bytes in 48Bytes block: 21 blocks per page
+    for (i = 0; i < 21; i++) {
+        CU_ASSERT(NULL != (mem[i] = cupkee_malloc(33)));
+    }
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    CU_ASSERT(NULL != (mem[i] = cupkee_malloc(48)));
+    CU_ASSERT(pages == memory_free_pages() + 2);
+    for (i = 0; i < 22; i++) {
+        cupkee_free(mem[i]);
+    }
+    CU_ASSERT(pages == memory_free_pages());
+
+    // 1Bytes in 16Bytes block: 64 blocks per page
+    for (i = 0; i < 64; i++) {
+        CU_ASSERT(NULL != (mem[i] = cupkee_malloc(1)));
+    }
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    for (i = 0; i < 64; i++) {
+        cupkee_free(mem[i]);
+    }
+    CU_ASSERT(pages == memory_free_pages());
+
+    // 257Bytes ~ 512Bytes in block, not page
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(257)));
+    CU_ASSERT(NULL != (mem[1] = cupkee_malloc(384)));
+    CU_ASSERT(NULL != (mem[2] = cupkee_malloc(385)));
+    CU_ASSERT(NULL != (mem[3] = cupkee_malloc(512)));
+    CU_ASSERT(pages == memory_free_pages() + 2);
+    for (i = 0; i < 4; i++) {
+        cupkee_free(mem[i]);
+    }
+    CU_ASSERT(pages == memory_free_pages());
+
+    // Page for size over 512Bytes
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(513)));
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    cupkee_free(mem[0]);
+    CU_ASSERT(pages == memory_free_pages());
+
+    hw_mock_deinit();
+}
+
+static void test_memory_cache(void)
+{
+    int i, pages;
+    uint32_t kept, reused;
+    void *mem[96];
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_cache_set(32, 2));
+    CU_ASSERT(0 > cupkee_memory_cache_set(1024, 1));
+    CU_ASSERT(0 > cupkee_memory_cache_set(32, -1));
+    pages = memory_free_pages();
+
+    // Empty page is kept by queue
+    for (i = 0; i < 10; i++) {
+        CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+        CU_ASSERT(pages == memory_free_pages() + 1);
+        cupkee_free(mem[0]);
+        CU_ASSERT(pages == memory_free_pages() + 1);
+    }
+    cupkee_memory_cache_stat(&kept, &reused);
+    CU_ASSERT(kept == 10);
+    CU_ASSERT(reused == 9);
+
+    // Cache up to 2 pages
+    for (i = 0; i < 96; i++) {
+        CU_ASSERT(NULL != (mem[i] = cupkee_malloc(32)));
+    }
+    CU_ASSERT(pages == memory_free_pages() + 3);
+    for (i = 0; i < 96; i++) {
+        cupkee_free(mem[i]);
+    }
+    CU_ASSERT(pages == memory_free_pages() + 2);
+
+    // Release cached pages
+    CU_ASSERT(2 == cupkee_memory_reclaim());
+    CU_ASSERT(pages == memory_free_pages());
+
+    // Cached pages is released, if memory is not enough
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+    cupkee_free(mem[0]);
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    CU_ASSERT(NULL != (mem[0] = cupkee_page_alloc(3)));
+    CU_ASSERT(NULL != (mem[1] = cupkee_page_alloc(2)));
+    CU_ASSERT(NULL != (mem[2] = cupkee_page_alloc(1)));
+    CU_ASSERT(NULL != (mem[3] = cupkee_page_alloc(0)));
+    CU_ASSERT(0 == memory_free_pages());
+    for (i = 0; i < 4; i++) {
+        cupkee_page_free(mem[i]);
+    }
+    CU_ASSERT(pages == memory_free_pages());
+
+    // Trim to new limit
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+    cupkee_free(mem[0]);
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    CU_ASSERT(0 == cupkee_memory_cache_set(32, 0));
+    CU_ASSERT(pages == memory_free_pages());
+
+    hw_mock_deinit();
+}
+
+static uint8_t extend_memory[8 * 1024 + 1023];
+
+static int memory_in_extend(void *p)
+{
+    return (uint8_t *)p >= extend_memory && (uint8_t *)p < extend_memory + sizeof(extend_memory);
+}
+
+static void test_memory_extend(void)
+{
+    int i, pages, zone, ext;
+    void *mem[32];
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_cache_set(0, 0));
+    pages = memory_free_pages();
+
+    // Invalid region
+    CU_ASSERT(0 > cupkee_memory_extend(0, 8 * 1024));
+    CU_ASSERT(0 > cupkee_memory_extend((intptr_t)extend_memory, 1024));
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(1024)));
+    CU_ASSERT(0 > cupkee_memory_extend((intptr_t)mem[0], 8 * 1024));
+    cupkee_free(mem[0]);
+
+    zone = cupkee_memory_extend((intptr_t)extend_memory, sizeof(extend_memory));
+    CU_ASSERT(zone == 1);
+    // 7 or 8 pages, depend on alignment of extend_memory
+    ext = memory_free_pages() - pages;
+    CU_ASSERT(ext == 7 || ext == 8);
+    CU_ASSERT(0 > cupkee_memory_extend((intptr_t)extend_memory, sizeof(extend_memory)));
+
+    // Boot zone is used first
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(1024)));
+    CU_ASSERT(!memory_in_extend(mem[0]));
+    cupkee_free(mem[0]);
+
+    // Extend zone is used, when boot zone is full
+    for (i = 0; i < pages + ext; i++) {
+        CU_ASSERT(NULL != (mem[i] = cupkee_malloc(1024)));
+        CU_ASSERT(cupkee_memory_page(mem[i]) != NULL);
+        CU_ASSERT(cupkee_page_memory(cupkee_memory_page(mem[i])) == mem[i]);
+        CU_ASSERT(memory_in_extend(mem[i]) == (i >= pages));
+    }
+    CU_ASSERT(NULL == cupkee_malloc(1024));
+    CU_ASSERT(0 == memory_free_pages());
+    for (i = 0; i < pages + ext; i++) {
+        cupkee_free(mem[i]);
+    }
+    CU_ASSERT(pages + ext == memory_free_pages());
+
+    // Prefer extend zone
+    CU_ASSERT(0 > cupkee_memory_prefer(2, 1));
+    CU_ASSERT(0 == cupkee_memory_prefer(zone, 1));
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+    CU_ASSERT(NULL != (mem[1] = cupkee_malloc(2048)));
+    CU_ASSERT(memory_in_extend(mem[0]));
+    CU_ASSERT(memory_in_extend(mem[1]));
+    cupkee_free(mem[0]);
+    cupkee_free(mem[1]);
+
+    CU_ASSERT(0 == cupkee_memory_prefer(0, 2));
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+    CU_ASSERT(!memory_in_extend(mem[0]));
+    cupkee_free(mem[0]);
+    CU_ASSERT(pages + ext == memory_free_pages());
+
+    // Not memory of heap
+    CU_ASSERT(NULL == cupkee_memory_page(extend_memory + sizeof(extend_memory)));
+    CU_ASSERT(NULL == cupkee_memory_page(&pages));
+
+    hw_mock_deinit();
+}
+
+static void test_memory_stats(void)
+{
+    int i, pages;
+    cupkee_memory_stat_t stat;
+    void *mem[4];
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_cache_set(0, 0));
+    CU_ASSERT(0 > cupkee_memory_stats(NULL));
+    pages = memory_free_pages();
+
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.bytes_used == 0);
+    CU_ASSERT(stat.free_bytes == pages * CUPKEE_PAGE_SIZE);
+    for (i = 0; i < CUPKEE_PAGE_ORDERR_MAX; i++) {
+        CU_ASSERT(stat.free_pages[i] == (uint32_t)cupkee_free_pages(i));
+    }
+
+    // Block and page allocation is accounted
+    CU_ASSERT(NULL != (mem[0] = cupkee_malloc(32)));
+    CU_ASSERT(NULL != (mem[1] = cupkee_malloc(32)));
+    CU_ASSERT(NULL != (mem[2] = cupkee_malloc(2048)));
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.bytes_used == 32 * 2 + 2048);
+    CU_ASSERT(stat.free_bytes == (pages - 3) * CUPKEE_PAGE_SIZE);
+    for (i = 0; i < CUPKEE_MBCQ_MAX; i++) {
+        if (stat.mbcq_size[i] == 32) {
+            CU_ASSERT(stat.mbcq_pages[i] == 1);
+            CU_ASSERT(stat.mbcq_blocks[i] == 2);
+        } else {
+            CU_ASSERT(stat.mbcq_pages[i] == 0);
+        }
+    }
+
+    // Peak is kept after free
+    cupkee_free(mem[0]);
+    cupkee_free(mem[1]);
+    cupkee_free(mem[2]);
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.bytes_used == 0);
+    CU_ASSERT(stat.bytes_peak == 32 * 2 + 2048);
+    CU_ASSERT(stat.free_bytes == pages * CUPKEE_PAGE_SIZE);
+
+    // Failure is counted
+    CU_ASSERT(NULL == cupkee_malloc(pages * CUPKEE_PAGE_SIZE * 2));
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.alloc_fails == 1);
+
+    // Fragmentation
+    CU_ASSERT(stat.largest_free <= stat.free_bytes);
+    CU_ASSERT(stat.fragment <= 100);
+    CU_ASSERT(NULL != (mem[3] = cupkee_page_alloc(0)));
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.fragment > 0);
+    cupkee_page_free(mem[3]);
+
+    hw_mock_deinit();
+}
+
+static int memory_check(uint8_t *p, int n, uint8_t v)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (p[i] != (uint8_t)(v + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void memory_fill(uint8_t *p, int n, uint8_t v)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        p[i] = v + i;
+    }
+}
+
+static void test_memory_realloc(void)
+{
+    int pages;
+    uint8_t *p, *q;
+    cupkee_page_t *page[4];
+    cupkee_memory_stat_t stat;
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_cache_set(0, 0));
+    pages = memory_free_pages();
+
+    // Act as malloc & free
+    CU_ASSERT(NULL != (p = cupkee_realloc(NULL, 32)));
+    CU_ASSERT(pages == memory_free_pages() + 1);
+    CU_ASSERT(NULL == cupkee_realloc(p, 0));
+    CU_ASSERT(pages == memory_free_pages());
+
+    // Block stay in the same class
+    CU_ASSERT(NULL != (p = cupkee_malloc(20)));
+    memory_fill(p, 20, 1);
+    CU_ASSERT(p == cupkee_realloc(p, 24));
+    CU_ASSERT(p == cupkee_realloc(p, 8));
+    CU_ASSERT(NULL != (q = cupkee_realloc(p, 100)));
+    CU_ASSERT(q != p);
+    CU_ASSERT(memory_check(q, 20, 1));
+    CU_ASSERT(NULL != (p = cupkee_realloc(q, 2000)));
+    CU_ASSERT(memory_check(p, 20, 1));
+    cupkee_free(p);
+    CU_ASSERT(pages == memory_free_pages());
+
+    // Take small pieces away, let page 0 ~ 7 be the only free block
+    CU_ASSERT(NULL != (page[0] = cupkee_page_alloc(0)));
+    CU_ASSERT(NULL != (page[1] = cupkee_page_alloc(1)));
+    CU_ASSERT(NULL != (page[2] = cupkee_page_alloc(2)));
+    CU_ASSERT(NULL != (p = cupkee_malloc(1024)));
+    CU_ASSERT(1 == cupkee_free_pages(0));
+    CU_ASSERT(1 == cupkee_free_pages(1));
+    CU_ASSERT(1 == cupkee_free_pages(2));
+    memory_fill(p, 1024, 3);
+
+    // Grow in place
+    CU_ASSERT(p == cupkee_realloc(p, 8 * 1024));
+    CU_ASSERT(0 == memory_free_pages());
+    CU_ASSERT(memory_check(p, 1024, 3));
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.bytes_used == 8 * 1024 + 7 * 1024); // pages taken are in use too
+
+    // Shrink in place
+    CU_ASSERT(p == cupkee_realloc(p, 1000));
+    CU_ASSERT(1 == cupkee_free_pages(0));
+    CU_ASSERT(1 == cupkee_free_pages(1));
+    CU_ASSERT(1 == cupkee_free_pages(2));
+    CU_ASSERT(memory_check(p, 1000, 3));
+    CU_ASSERT(0 == cupkee_memory_stats(&stat));
+    CU_ASSERT(stat.bytes_used == 1024 + 7 * 1024);
+
+    CU_ASSERT(p == cupkee_realloc(p, 3000));
+    CU_ASSERT(0 == cupkee_free_pages(0));
+    CU_ASSERT(0 == cupkee_free_pages(1));
+    CU_ASSERT(1 == cupkee_free_pages(2));
+    CU_ASSERT(p == cupkee_realloc(p, 1024));
+    CU_ASSERT(memory_check(p, 1000, 3));
+
+    // Buddy is inused, move to new place
+    CU_ASSERT(NULL != (page[3] = cupkee_page_alloc(0)));
+    CU_ASSERT(NULL != (q = cupkee_realloc(p, 2048)));
+    CU_ASSERT(q != p);
+    CU_ASSERT(memory_check(q, 1024, 3));
+
+    // Original memory is kept, if no memory
+    CU_ASSERT(NULL == cupkee_realloc(q, 8 * 1024));
+    CU_ASSERT(memory_check(q, 1024, 3));
+    CU_ASSERT(NULL == cupkee_realloc(q, 64 * 1024));
+    CU_ASSERT(memory_check(q, 1024, 3));
+    cupkee_free(q);
+
+    cupkee_page_free(page[0]);
+    cupkee_page_free(page[1]);
+    cupkee_page_free(page[2]);
+    cupkee_page_free(page[3]);
+    CU_ASSERT(pages == memory_free_pages());
+    CU_ASSERT(1 == cupkee_free_pages(3));
+
+    hw_mock_deinit();
+}
+
+#if CUPKEE_MEMORY_TRACE
+static void test_memory_trace(void)
+{
+    cupkee_memory_trace_t rec[4];
+    void *p, *q;
+    int i;
+
+    hw_mock_init(16 * 1024 + 1023);
+
+    CU_ASSERT(0 == cupkee_memory_setup());
+    CU_ASSERT(0 == cupkee_memory_trace_read(rec, 4));
+
+    CU_ASSERT(NULL != (p = cupkee_malloc(32)));
+    CU_ASSERT(NULL != (q = cupkee_realloc(p, 2000)));
+    cupkee_free(q);
+
+    CU_ASSERT(3 == cupkee_memory_trace_read(rec, 4));
+    CU_ASSERT(rec[0].op == CUPKEE_TRACE_ALLOC && rec[0].size == 32);
+    CU_ASSERT(rec[0].ptr == (uintptr_t)p && rec[0].order == CUPKEE_TRACE_ORDER_BLOCK);
+    CU_ASSERT(rec[1].op == CUPKEE_TRACE_REALLOC && rec[1].size == 2000);
+    CU_ASSERT(rec[1].ptr == (uintptr_t)q && rec[1].prev == (uintptr_t)p && rec[1].order == 1);
+    CU_ASSERT(rec[2].op == CUPKEE_TRACE_FREE && rec[2].ptr == (uintptr_t)q);
+    CU_ASSERT(0 == cupkee_memory_trace_read(rec, 4));
+
+    // Oldest records are dropped
+    for (i = 0; i < CUPKEE_MEMORY_TRACE_SIZE + 2; i++) {
+        cupkee_free(cupkee_malloc(i + 1));
+    }
+    CU_ASSERT(cupkee_memory_trace_lost() == CUPKEE_MEMORY_TRACE_SIZE + 4);
+    CU_ASSERT(4 == cupkee_memory_trace_read(rec, 4));
+    CU_ASSERT(rec[0].op == CUPKEE_TRACE_ALLOC && rec[0].size == CUPKEE_MEMORY_TRACE_SIZE / 2 + 3);
+
+    hw_mock_deinit();
+}
+#endif
+
 CU_pSuite test_sys_memory(void)
 {
     CU_pSuite suite = CU_add_suite("system memory", test_setup, test_clean);
@@ -289,6 +735,15 @@ CU_pSuite test_sys_memory(void)
         CU_add_test(suite, "sys memory init  ", test_memory_init);
         CU_add_test(suite, "sys page alloc   ", test_page_alloc);
         CU_add_test(suite, "sys memory alloc ", test_memory_alloc);
+        CU_add_test(suite, "sys memory reuse ", test_memory_partial);
+        CU_add_test(suite, "sys memory class ", test_memory_class);
+        CU_add_test(suite, "sys memory cache ", test_memory_cache);
+        CU_add_test(suite, "sys memory extend", test_memory_extend);
+        CU_add_test(suite, "sys memory stats ", test_memory_stats);
+        CU_add_test(suite, "sys memory resize", test_memory_realloc);
+#if CUPKEE_MEMORY_TRACE
+        CU_add_test(suite, "sys memory trace ", test_memory_trace);
+#endif
     }
 
     return suite;
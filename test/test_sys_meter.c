@@ -0,0 +1,120 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+#define US      (1000)              // hw_cycle_freq() of mock is 1GHz
+#define MS      (1000 * US)
+
+static int test_setup(void)
+{
+    return TU_pre_init();
+}
+
+static int test_clean(void)
+{
+    return TU_pre_deinit();
+}
+
+#if CUPKEE_METER
+/* Iteration of 1ms: 100us polling device, 200us dispatching events of which
+ * 150us in object handler of tag 2, every other one did nothing.
+ */
+static uint32_t meter_run(uint32_t now, int loops)
+{
+    int i;
+
+    for (i = 0; i < loops; i++) {
+        int worked = i & 1;
+
+        cupkee_meter_add(CUPKEE_METER_DEVICE, now, now + 100 * US);
+        if (worked) {
+            cupkee_meter_add(CUPKEE_METER_OBJECT + 2, now + 120 * US, now + 270 * US);
+            cupkee_meter_add(CUPKEE_METER_EVENT, now + 100 * US, now + 300 * US);
+        }
+        cupkee_meter_loop(now, now + MS, worked);
+        now += MS;
+        _cupkee_systicks++;
+    }
+
+    return now;
+}
+
+static void test_meter_window(void)
+{
+    cupkee_meter_stat_t stat;
+    uint32_t now;
+
+    _cupkee_systicks = 0;
+    cupkee_meter_setup();
+    now = hw_cycle_count();
+
+    // Nothing finished
+    CU_ASSERT(0 == cupkee_meter_stats(&stat));
+    CU_ASSERT(stat.window == 0 && stat.loops == 0);
+
+    // A long iteration, in slot finished
+    now = meter_run(now, CUPKEE_METER_SLOT_MS * (CUPKEE_METER_SLOTS - 1));
+    cupkee_meter_loop(now, now + 7 * MS, 1);
+    _cupkee_systicks += 7;
+    now = meter_run(now + 7 * MS, CUPKEE_METER_SLOT_MS);
+
+    CU_ASSERT(0 == cupkee_meter_stats(&stat));
+    CU_ASSERT(stat.window >= CUPKEE_METER_SLOT_MS * CUPKEE_METER_SLOTS - 1);
+    CU_ASSERT(stat.window <= CUPKEE_METER_SLOT_MS * CUPKEE_METER_SLOTS + 7);
+    CU_ASSERT(stat.loops >= CUPKEE_METER_SLOT_MS * CUPKEE_METER_SLOTS - 8);
+    CU_ASSERT(stat.loops_per_sec > 950 && stat.loops_per_sec <= 1000);
+    CU_ASSERT(stat.idle * 2 >= stat.loops - 3 && stat.idle * 2 <= stat.loops + 3);
+    CU_ASSERT(stat.loop_max == 7000);
+    CU_ASSERT(stat.time[CUPKEE_METER_DEVICE] == (stat.loops - 1) * 100);
+    CU_ASSERT(stat.time[CUPKEE_METER_OBJECT + 2] == (stat.loops - stat.idle - 1) * 150);
+    CU_ASSERT(stat.time[CUPKEE_METER_EVENT] == (stat.loops - stat.idle - 1) * 200);
+    CU_ASSERT(stat.time[CUPKEE_METER_PIN] == 0);
+
+    // Window slide, the long one left
+    now = meter_run(now, CUPKEE_METER_SLOT_MS * CUPKEE_METER_SLOTS + 10);
+    CU_ASSERT(0 == cupkee_meter_stats(&stat));
+    CU_ASSERT(stat.loop_max == 1000);
+
+    // Sleep 100s in idle, cycle counter wrapped & stopped meanwhile
+    cupkee_meter_loop(now, now + MS, 0);
+    _cupkee_systicks += 100000;
+    now = meter_run(now + MS, CUPKEE_METER_SLOT_MS * CUPKEE_METER_SLOTS);
+    CU_ASSERT(0 == cupkee_meter_stats(&stat));
+    CU_ASSERT(stat.window >= 100000 && stat.window <= 100000 + CUPKEE_METER_SLOT_MS * CUPKEE_METER_SLOTS);
+    CU_ASSERT(stat.loops_per_sec < 15);
+}
+
+#endif
+
+CU_pSuite test_sys_meter(void)
+{
+    CU_pSuite suite = CU_add_suite("system meter", test_setup, test_clean);
+
+    if (suite) {
+#if CUPKEE_METER
+        CU_add_test(suite, "meter window     ", test_meter_window);
+#endif
+    }
+
+    return suite;
+}
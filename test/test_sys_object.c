@@ -42,6 +42,58 @@ static void test_read(void)
     CU_ASSERT(1);
 }
 
+typedef struct pool_entry_t {
+    int value;
+    uint8_t data[20];
+} pool_entry_t;
+
+static const cupkee_desc_t pool_desc = {
+    .name = "pool"
+};
+
+static void test_pool(void)
+{
+    int tag, i;
+    uint32_t used;
+    cupkee_object_t *obj[3];
+    cupkee_memory_stat_t stat;
+
+    CU_ASSERT(0 < (tag = cupkee_object_register(sizeof(pool_entry_t), &pool_desc, 2)));
+
+    // Reserved objects come from pool, no heap memory is used
+    cupkee_memory_stats(&stat);
+    used = stat.bytes_used;
+    CU_ASSERT(NULL != (obj[0] = cupkee_object_create(tag)));
+    CU_ASSERT(NULL != (obj[1] = cupkee_object_create_with_id(tag)));
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(used == stat.bytes_used);
+    CU_ASSERT(obj[1]->id != CUPKEE_ID_INVALID);
+
+    // Pool is exhausted, heap is used
+    CU_ASSERT(NULL != (obj[2] = cupkee_object_create(tag)));
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(used < stat.bytes_used);
+    for (i = 0; i < 3; i++) {
+        CU_ASSERT(obj[i]->tag == tag);
+        CU_ASSERT(((pool_entry_t *)obj[i]->entry)->value == 0);
+        ((pool_entry_t *)obj[i]->entry)->value = i + 1;
+    }
+
+    cupkee_object_destroy(obj[2]);
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(used == stat.bytes_used);
+
+    // Slot is reused
+    cupkee_object_destroy(obj[1]);
+    CU_ASSERT(obj[1] == cupkee_object_create(tag));
+    CU_ASSERT(((pool_entry_t *)obj[1]->entry)->value == 0);
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(used == stat.bytes_used);
+
+    cupkee_object_destroy(obj[0]);
+    cupkee_object_destroy(obj[1]);
+}
+
 CU_pSuite test_sys_object(void)
 {
     CU_pSuite suite = CU_add_suite("system object", test_setup, test_clean);
@@ -49,6 +101,7 @@ CU_pSuite test_sys_object(void)
     if (suite) {
         CU_add_test(suite, "object register  ", test_register);
         CU_add_test(suite, "object read      ", test_read);
+        CU_add_test(suite, "object pool      ", test_pool);
     }
 
     return suite;
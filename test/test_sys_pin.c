@@ -104,6 +104,11 @@ static void test_group(void)
     CU_ASSERT(0 > cupkee_elem_set(grp, 4, CUPKEE_OBJECT_ELEM_INT, 0));
     CU_ASSERT(CUPKEE_OBJECT_ELEM_NV == cupkee_elem_get(grp, 4, &v));
 
+    // Pin popped is left in group buffer, out of elements
+    CU_ASSERT(3 == cupkee_pin_group_pop(grp));
+    CU_ASSERT(0 > cupkee_elem_set(grp, 3, CUPKEE_OBJECT_ELEM_INT, 0));
+    CU_ASSERT(CUPKEE_OBJECT_ELEM_NV == cupkee_elem_get(grp, 3, &v));
+
     CU_ASSERT(0 == cupkee_release(grp));
 }
 
@@ -0,0 +1,214 @@
+/* GPLv2 License
+ *
+ * Copyright (C) 2016-2018 Lixing Ding <ding.lixing@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "test.h"
+
+#define BLOCK_SIZE      (30)
+#define BLOCK_NUM       (16)
+#define HAMMER_TIMES    (100000)
+
+static int test_setup(void)
+{
+    return TU_pre_init();
+}
+
+static int test_clean(void)
+{
+    return TU_pre_deinit();
+}
+
+static intptr_t pool_mem[BLOCK_NUM * 4 + 1];
+
+static void test_pool_basic(void)
+{
+    cupkee_pool_t pool, *heap_pool;
+    void *b[BLOCK_NUM];
+    int i;
+
+    CU_ASSERT(0 > cupkee_pool_init(&pool, pool_mem, 0, 4));
+    CU_ASSERT(0 > cupkee_pool_init(&pool, pool_mem, 8, 0));
+    CU_ASSERT(0 > cupkee_pool_init(&pool, NULL, 8, 4));
+    CU_ASSERT(0 > cupkee_pool_init(&pool, (uint8_t *)pool_mem + 1, 8, 4));
+    CU_ASSERT(0 == cupkee_pool_init(&pool, pool_mem, BLOCK_SIZE, 4));
+    CU_ASSERT(cupkee_pool_block_size(&pool) >= BLOCK_SIZE);
+    CU_ASSERT(4 == cupkee_pool_free_num(&pool));
+
+    for (i = 0; i < 4; i++) {
+        CU_ASSERT(NULL != (b[i] = cupkee_pool_alloc(&pool)));
+        memset(b[i], i, BLOCK_SIZE);
+    }
+    CU_ASSERT(NULL == cupkee_pool_alloc(&pool));
+    CU_ASSERT(0 == cupkee_pool_free_num(&pool));
+    for (i = 0; i < 4; i++) {
+        CU_ASSERT(((uint8_t *)b[i])[BLOCK_SIZE - 1] == i);
+    }
+
+    // Not block of pool
+    cupkee_pool_free(&pool, pool_mem + BLOCK_NUM * 4);
+    cupkee_pool_free(&pool, (uint8_t *)b[0] + 1);
+    CU_ASSERT(0 == cupkee_pool_free_num(&pool));
+
+    cupkee_pool_free(&pool, b[2]);
+    CU_ASSERT(b[2] == cupkee_pool_alloc(&pool));
+    for (i = 0; i < 4; i++) {
+        cupkee_pool_free(&pool, b[i]);
+    }
+    CU_ASSERT(4 == cupkee_pool_free_num(&pool));
+
+    CU_ASSERT(NULL != (heap_pool = cupkee_pool_create(BLOCK_SIZE, BLOCK_NUM)));
+    for (i = 0; i < BLOCK_NUM; i++) {
+        CU_ASSERT(NULL != (b[i] = cupkee_pool_alloc(heap_pool)));
+    }
+    CU_ASSERT(NULL == cupkee_pool_alloc(heap_pool));
+    for (i = 0; i < BLOCK_NUM; i++) {
+        cupkee_pool_free(heap_pool, b[i]);
+    }
+    CU_ASSERT(BLOCK_NUM == cupkee_pool_free_num(heap_pool));
+    cupkee_pool_release(heap_pool);
+}
+
+/* One thread plays interrupt: takes blocks, stamps them and hands them to
+ * main loop through a single producer ring; the other plays main loop: checks
+ * and frees the handed blocks, and takes its own blocks meanwhile.
+ */
+static cupkee_pool_t hammer_pool;
+static void *hammer_ring[BLOCK_NUM];
+static uint32_t hammer_head, hammer_tail;
+static int hammer_corrupt;
+static int hammer_done;
+
+static void block_stamp(uint8_t *b, uint8_t v)
+{
+    memset(b, v, BLOCK_SIZE);
+}
+
+static int block_check(uint8_t *b, uint8_t v)
+{
+    int i;
+
+    for (i = 0; i < BLOCK_SIZE; i++) {
+        if (b[i] != v) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void *hammer_isr(void *arg)
+{
+    int n = 0;
+
+    (void) arg;
+
+    while (n < HAMMER_TIMES) {
+        uint32_t head = __atomic_load_n(&hammer_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&hammer_tail, __ATOMIC_ACQUIRE);
+        uint8_t *b;
+
+        if (tail - head >= BLOCK_NUM || NULL == (b = cupkee_pool_alloc(&hammer_pool))) {
+            sched_yield();
+            continue;
+        }
+
+        block_stamp(b, (uint8_t)n);
+        hammer_ring[tail % BLOCK_NUM] = b;
+        __atomic_store_n(&hammer_tail, tail + 1, __ATOMIC_RELEASE);
+        n++;
+    }
+    __atomic_store_n(&hammer_done, 1, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+static void *hammer_main(void *arg)
+{
+    uint32_t n = 0;
+
+    (void) arg;
+
+    while (1) {
+        uint32_t tail = __atomic_load_n(&hammer_tail, __ATOMIC_ACQUIRE);
+        uint8_t *own = cupkee_pool_alloc(&hammer_pool);
+
+        if (own) {
+            block_stamp(own, 0xAA);
+        }
+
+        while (hammer_head != tail) {
+            uint8_t *b = hammer_ring[hammer_head % BLOCK_NUM];
+
+            if (!block_check(b, (uint8_t)n++)) {
+                hammer_corrupt++;
+            }
+            cupkee_pool_free(&hammer_pool, b);
+            __atomic_store_n(&hammer_head, hammer_head + 1, __ATOMIC_RELEASE);
+        }
+
+        if (own) {
+            if (!block_check(own, 0xAA)) {
+                hammer_corrupt++;
+            }
+            cupkee_pool_free(&hammer_pool, own);
+        }
+
+        if (__atomic_load_n(&hammer_done, __ATOMIC_ACQUIRE) &&
+            hammer_head == __atomic_load_n(&hammer_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        sched_yield();
+    }
+
+    return (void *)(intptr_t)n;
+}
+
+static void test_pool_hammer(void)
+{
+    pthread_t isr, loop;
+    void *handled;
+
+    CU_ASSERT(0 == cupkee_pool_init(&hammer_pool, pool_mem, BLOCK_SIZE, BLOCK_NUM));
+    hammer_head = hammer_tail = 0;
+    hammer_corrupt = hammer_done = 0;
+
+    CU_ASSERT(0 == pthread_create(&loop, NULL, hammer_main, NULL));
+    CU_ASSERT(0 == pthread_create(&isr, NULL, hammer_isr, NULL));
+    pthread_join(isr, NULL);
+    pthread_join(loop, &handled);
+
+    CU_ASSERT(HAMMER_TIMES == (intptr_t)handled);
+    CU_ASSERT(0 == hammer_corrupt);
+    CU_ASSERT(BLOCK_NUM == cupkee_pool_free_num(&hammer_pool));
+}
+
+CU_pSuite test_sys_pool(void)
+{
+    CU_pSuite suite = CU_add_suite("system pool", test_setup, test_clean);
+
+    if (suite) {
+        CU_add_test(suite, "pool basic       ", test_pool_basic);
+        CU_add_test(suite, "pool hammer      ", test_pool_hammer);
+    }
+
+    return suite;
+}
@@ -78,11 +78,15 @@ static void test_next(void)
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 9);
 
     cupkee_process_next(curr_process_entry);
+    CU_ASSERT(cupkee_process_pending());
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
     CU_ASSERT(call_process_count == 2);
     CU_ASSERT(cupkee_process_step(curr_process_entry) == 1);
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 9);
 
     cupkee_process_next(curr_process_entry);
+    CU_ASSERT(cupkee_process_pending());
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
     CU_ASSERT(call_process_count == 3);
     CU_ASSERT(cupkee_process_step(curr_process_entry) == 2);
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 9);
@@ -103,11 +107,15 @@ static void test_goto(void)
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 8);
 
     cupkee_process_goto(curr_process_entry, 15);
+    CU_ASSERT(call_process_count == 1);
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
     CU_ASSERT(call_process_count == 2);
     CU_ASSERT(cupkee_process_step(curr_process_entry) == 15);
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 8);
 
     cupkee_process_next(curr_process_entry);
+    CU_ASSERT(cupkee_process_pending());
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
     CU_ASSERT(call_process_count == 3);
     CU_ASSERT(cupkee_process_step(curr_process_entry) == 16);
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 8);
@@ -128,6 +136,8 @@ static void test_fail(void)
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 9);
 
     cupkee_process_next(curr_process_entry);
+    CU_ASSERT(cupkee_process_pending());
+    CU_ASSERT(1 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
     CU_ASSERT(call_process_count == 2);
     CU_ASSERT(cupkee_process_step(curr_process_entry) == 1);
     CU_ASSERT(cupkee_process_data(curr_process_entry) == 9);
@@ -137,6 +147,170 @@ static void test_fail(void)
     CU_ASSERT(last_process_state == -5);
 }
 
+#define DEEP_STEPS  10000
+
+static uintptr_t stack_top, stack_bottom;
+
+static void test_deep_task(void *entry)
+{
+    uintptr_t sp = (uintptr_t)&entry;
+
+    call_process_count++;
+    if (!stack_top || sp > stack_top) {
+        stack_top = sp;
+    }
+    if (!stack_bottom || sp < stack_bottom) {
+        stack_bottom = sp;
+    }
+
+    if (call_process_count < DEEP_STEPS) {
+        cupkee_process_next(entry);
+    } else {
+        cupkee_process_done(entry);
+    }
+}
+
+static void test_deep(void)
+{
+    int loops = 0;
+
+    call_process_count = 0;
+    last_process_state = -1;
+    stack_top = 0;
+    stack_bottom = 0;
+
+    CU_ASSERT(0 == cupkee_process_start(test_deep_task, 1, test_process_finish));
+    while (cupkee_process_pending() && loops < DEEP_STEPS) {
+        cupkee_process_poll(CUPKEE_PROCESS_BUDGET);
+        loops++;
+    }
+
+    CU_ASSERT(call_process_count == DEEP_STEPS);
+    CU_ASSERT(last_process_state == CUPKEE_OK);
+    CU_ASSERT(loops == (DEEP_STEPS - 1 + CUPKEE_PROCESS_BUDGET - 1) / CUPKEE_PROCESS_BUDGET);
+
+    // Stack not grow with steps, one frame of poll at most
+    CU_ASSERT(stack_top - stack_bottom < 256);
+}
+
+static int fair_trace[8];
+static int fair_count;
+
+static void test_fair_task(void *entry)
+{
+    if (fair_count < 8) {
+        fair_trace[fair_count++] = cupkee_process_data(entry);
+    }
+
+    if (cupkee_process_step(entry) < 3) {
+        cupkee_process_next(entry);
+    } else {
+        cupkee_process_done(entry);
+    }
+}
+
+static void test_fair(void)
+{
+    static const int expect[8] = {1, 2, 1, 2, 1, 2, 1, 2};
+    void *entry;
+
+    fair_count = 0;
+    last_process_state = -1;
+
+    // Steps of two processes take turns
+    CU_ASSERT(0 == cupkee_process_start(test_fair_task, 1, NULL));
+    CU_ASSERT(0 == cupkee_process_start(test_fair_task, 2, NULL));
+    while (cupkee_process_pending()) {
+        CU_ASSERT(1 == cupkee_process_poll(1));
+    }
+    CU_ASSERT(0 == memcmp(fair_trace, expect, sizeof(expect)));
+
+    // Fail while waiting to run, removed from queue
+    call_process_count = 0;
+    CU_ASSERT(0 == cupkee_process_start(test_process_task, 7, test_process_finish));
+    entry = curr_process_entry;
+    cupkee_process_next(entry);
+    cupkee_process_next(entry);
+    CU_ASSERT(cupkee_process_step(entry) == 2);
+    cupkee_process_fail(entry, -3);
+    CU_ASSERT(last_process_state == -3 && last_process_data == 7);
+    CU_ASSERT(!cupkee_process_pending());
+    CU_ASSERT(0 == cupkee_process_poll(CUPKEE_PROCESS_BUDGET));
+    CU_ASSERT(call_process_count == 1);
+}
+
+static int wait_obj_id;
+static int wait_woken[4];
+static uint32_t wait_at[4];
+
+static void test_wait_task(void *entry)
+{
+    int step = cupkee_process_step(entry);
+
+    wait_at[step] = _cupkee_systicks;
+    wait_woken[step] = cupkee_process_woken(entry);
+
+    // Straight line steps: sleep, wait event in time, and wait event timeout
+    switch (step) {
+    case 0:
+        cupkee_process_wait_timeout(entry, 50);
+        break;
+    case 1:
+    case 2:
+        cupkee_process_wait_object(entry, wait_obj_id, CUPKEE_EVENT_DATA);
+        cupkee_process_wait_timeout(entry, 30);
+        break;
+    default:
+        cupkee_process_done(entry);
+    }
+}
+
+static void wait_tick(void)
+{
+    _cupkee_systicks++;
+    cupkee_event_post_systick();
+    cupkee_event_poll();
+    cupkee_process_poll(CUPKEE_PROCESS_BUDGET);
+}
+
+static void test_wait(void)
+{
+    void *obj;
+
+    CU_ASSERT_FATAL(NULL != (obj = cupkee_timer_request(NULL, 0)));
+    wait_obj_id = CUPKEE_ENTRY_ID(obj);
+    memset(wait_at, 0, sizeof(wait_at));
+    last_process_state = -1;
+
+    _cupkee_systicks = 0;
+    CU_ASSERT(0 == cupkee_process_start(test_wait_task, 0, test_process_finish));
+    CU_ASSERT(!cupkee_process_pending());
+    CU_ASSERT(cupkee_process_deadline(0) == 50);
+
+    while (_cupkee_systicks < 60) {
+        wait_tick();
+    }
+    CU_ASSERT(wait_at[1] == 50 && wait_woken[1] == -CUPKEE_ETIMEOUT);
+    CU_ASSERT(cupkee_process_deadline(_cupkee_systicks) == 20);
+
+    // Object event come before timeout
+    cupkee_object_event_post(wait_obj_id, CUPKEE_EVENT_DATA);
+    wait_tick();
+    CU_ASSERT(wait_at[2] == 61 && wait_woken[2] == CUPKEE_EVENT_DATA);
+
+    // Other event of object is ignored
+    cupkee_object_event_post(wait_obj_id, CUPKEE_EVENT_ERROR);
+    while (_cupkee_systicks < 100) {
+        wait_tick();
+    }
+    CU_ASSERT(wait_at[3] == 91 && wait_woken[3] == -CUPKEE_ETIMEOUT);
+    CU_ASSERT(last_process_state == CUPKEE_OK);
+    CU_ASSERT(cupkee_process_deadline(_cupkee_systicks) == CUPKEE_TICKS_FOREVER);
+
+    cupkee_release(obj);
+    cupkee_event_poll();
+}
+
 CU_pSuite test_sys_process(void)
 {
     CU_pSuite suite = CU_add_suite("system process", test_setup, test_clean);
@@ -146,6 +320,9 @@ CU_pSuite test_sys_process(void)
         CU_add_test(suite, "process next     ", test_next);
         CU_add_test(suite, "process goto     ", test_goto);
         CU_add_test(suite, "process fail     ", test_fail);
+        CU_add_test(suite, "process deep     ", test_deep);
+        CU_add_test(suite, "process fair     ", test_fair);
+        CU_add_test(suite, "process wait     ", test_wait);
     }
 
     return suite;
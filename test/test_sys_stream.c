@@ -95,7 +95,7 @@ static int test_setup(void)
 {
     TU_pre_init();
 
-    if (0 > (tag = cupkee_object_register(sizeof(cupkee_stream_t), &stream_desc))) {
+    if (0 > (tag = cupkee_object_register(sizeof(cupkee_stream_t), &stream_desc, 0))) {
         return -1;
     }
 
@@ -228,6 +228,141 @@ static void test_stream_event(void)
     CU_ASSERT(0 == cupkee_stream_deinit(s));
 }
 
+static void test_stream_block(void)
+{
+    int id;
+    cupkee_stream_t *s;
+    uint8_t buf[32];
+    void *b;
+
+    CU_ASSERT(0 <= (id = cupkee_create_id(tag)));
+    CU_ASSERT(NULL != (s = (cupkee_stream_t *) cupkee_id_entry(id, tag)));
+    CU_ASSERT(0 == cupkee_stream_init(s, id, 32, 32, mock_read, mock_write));
+
+    // rx: whole block is passed to user
+    CU_ASSERT(NULL != (b = cupkee_block_create(5, "hello")));
+    CU_ASSERT(0 == cupkee_stream_push_buf(s, b));
+    CU_ASSERT(5 == cupkee_stream_readable(s));
+    CU_ASSERT(b == cupkee_stream_read_buf(s));
+    CU_ASSERT(5 == cupkee_block_length(b) && !memcmp(cupkee_block_ptr(b), "hello", 5));
+    cupkee_block_release(b);
+
+    // rx: nothing to read, request driver as read does
+    mock_read_trigger = 0;
+    mock_read_immediately = 0;
+    CU_ASSERT(NULL == cupkee_stream_read_buf(s));
+    CU_ASSERT(1 == mock_read_trigger);
+
+    // rx: bytes in ring go first, bytes pushed after blocks stay behind
+    CU_ASSERT(2 == cupkee_stream_push(s, 2, "ab"));
+    CU_ASSERT(0 == cupkee_stream_push_buf(s, cupkee_block_create(3, "cde")));
+    CU_ASSERT(2 == cupkee_stream_push(s, 2, "fg"));
+    CU_ASSERT(7 == cupkee_stream_readable(s));
+    CU_ASSERT(4 == cupkee_stream_read(s, 4, buf) && !memcmp(buf, "abcd", 4));
+    CU_ASSERT(NULL != (b = cupkee_stream_read_buf(s)));
+    CU_ASSERT(3 == cupkee_block_length(b) && !memcmp(cupkee_block_ptr(b), "efg", 3));
+    cupkee_block_release(b);
+    CU_ASSERT(0 == cupkee_stream_read(s, 32, buf));
+
+    CU_ASSERT(2 == cupkee_stream_push(s, 2, "hi"));
+    CU_ASSERT(NULL != (b = cupkee_stream_read_buf(s)));
+    CU_ASSERT(2 == cupkee_block_length(b) && !memcmp(cupkee_block_ptr(b), "hi", 2));
+    cupkee_block_release(b);
+
+    // tx: whole block is passed to driver
+    mock_write_trigger = 0;
+    mock_write_immediately = 0;
+    CU_ASSERT(NULL != (b = cupkee_block_create(5, "world")));
+    CU_ASSERT(0 == cupkee_stream_write_buf(s, b));
+    CU_ASSERT(1 == mock_write_trigger);
+    CU_ASSERT(b == cupkee_stream_pull_buf(s));
+    cupkee_block_release(b);
+    CU_ASSERT(NULL == cupkee_stream_pull_buf(s));
+
+    // tx: order kept when mixed with copy api
+    CU_ASSERT(2 == cupkee_stream_write(s, 2, "ab"));
+    CU_ASSERT(2 == mock_write_trigger);
+    CU_ASSERT(0 == cupkee_stream_write_buf(s, cupkee_block_create(3, "cde")));
+    CU_ASSERT(2 == cupkee_stream_write(s, 2, "fg"));
+    CU_ASSERT(2 == mock_write_trigger);
+    CU_ASSERT(NULL != (b = cupkee_stream_pull_buf(s)));
+    CU_ASSERT(2 == cupkee_block_length(b) && !memcmp(cupkee_block_ptr(b), "ab", 2));
+    cupkee_block_release(b);
+    CU_ASSERT(5 == cupkee_stream_pull(s, 32, buf) && !memcmp(buf, "cdefg", 5));
+    CU_ASSERT(NULL == cupkee_stream_pull_buf(s));
+
+    // blocks left are released with stream
+    CU_ASSERT(0 == cupkee_stream_push_buf(s, cupkee_block_create(3, "xyz")));
+    CU_ASSERT(0 == cupkee_stream_write_buf(s, cupkee_block_create(3, "xyz")));
+
+    CU_ASSERT(0 == TU_object_event_dispatch());
+    CU_ASSERT(0 == cupkee_stream_deinit(s));
+}
+
+static void test_stream_block_pool(void)
+{
+    int id, i, n;
+    cupkee_stream_t *s;
+    uint8_t buf[CUPKEE_BLOCK_POOL_SIZE * 2];
+    uint32_t systicks = _cupkee_systicks;
+    void *b;
+
+    CU_ASSERT(0 <= (id = cupkee_create_id(tag)));
+    CU_ASSERT(NULL != (s = (cupkee_stream_t *) cupkee_id_entry(id, tag)));
+    CU_ASSERT(0 == cupkee_stream_init(s, id, 32, 32, mock_read, mock_write));
+
+    // rx: bytes pushed one by one behind a block, gathered into pooled block
+    CU_ASSERT(NULL != (b = cupkee_block_alloc(CUPKEE_BLOCK_POOL_SIZE + 1)));
+    CU_ASSERT(!cupkee_block_is_pooled(b));
+    CU_ASSERT(CUPKEE_BLOCK_POOL_SIZE + 1 == cupkee_block_set_length(b, CUPKEE_BLOCK_POOL_SIZE + 1));
+    CU_ASSERT(0 == cupkee_stream_push_buf(s, b));
+    for (i = 0; i < 40; i++) {
+        uint8_t c = i;
+        CU_ASSERT(1 == cupkee_stream_push(s, 1, &c));
+    }
+    CU_ASSERT(b == cupkee_stream_read_buf(s));
+    cupkee_block_release(b);
+    CU_ASSERT(NULL != (b = cupkee_stream_read_buf(s)));
+    CU_ASSERT(cupkee_block_is_pooled(b) && 40 == cupkee_block_length(b));
+    cupkee_block_release(b);
+
+    // rx: pool used up, driver is pushed back instead of using heap
+    CU_ASSERT(0 == cupkee_stream_push_buf(s, cupkee_block_create(1, "a")));
+    n = 0;
+    while (1 == cupkee_stream_push(s, 1, "b")) {
+        n++;
+    }
+    CU_ASSERT(n > 0 && n <= CUPKEE_BLOCK_POOL_SIZE * CUPKEE_BLOCK_POOL_NUM);
+    CU_ASSERT(n + 1 == cupkee_stream_readable(s));
+    while (cupkee_stream_read(s, sizeof(buf), buf) > 0)
+        ;
+    CU_ASSERT(NULL != (b = cupkee_block_alloc_pooled()));
+    cupkee_block_release(b);
+
+    // tx: heap block drained by driver, released in main loop
+    mock_write_immediately = 0;
+    CU_ASSERT(NULL != (b = cupkee_block_alloc(sizeof(buf))));
+    CU_ASSERT(sizeof(buf) == cupkee_block_set_length(b, sizeof(buf)));
+    CU_ASSERT(0 == cupkee_stream_write_buf(s, b));
+    CU_ASSERT(sizeof(buf) == cupkee_stream_pull(s, sizeof(buf), buf));
+    CU_ASSERT(!cupkee_block_queue_is_empty(&s->tx_done));
+    cupkee_stream_sync(s, systicks);
+    CU_ASSERT(cupkee_block_queue_is_empty(&s->tx_done));
+
+    // tx: driver hands heap block of pull_buf back
+    CU_ASSERT(NULL != (b = cupkee_block_alloc(sizeof(buf))));
+    CU_ASSERT(0 == cupkee_stream_write_buf(s, b));
+    CU_ASSERT(b == cupkee_stream_pull_buf(s));
+    cupkee_stream_free_buf(s, b);
+    CU_ASSERT(!cupkee_block_queue_is_empty(&s->tx_done));
+    cupkee_stream_sync(s, systicks);
+    CU_ASSERT(cupkee_block_queue_is_empty(&s->tx_done));
+
+    while (TU_object_event_dispatch())
+        ;
+    CU_ASSERT(0 == cupkee_stream_deinit(s));
+}
+
 CU_pSuite test_sys_stream(void)
 {
     CU_pSuite suite = CU_add_suite("system stream", test_setup, test_clean);
@@ -238,6 +373,8 @@ CU_pSuite test_sys_stream(void)
         CU_add_test(suite, "stream write     ", test_stream_write);
         CU_add_test(suite, "stream sync io   ", test_stream_sync);
         CU_add_test(suite, "stream event     ", test_stream_event);
+        CU_add_test(suite, "stream block     ", test_stream_block);
+        CU_add_test(suite, "stream block pool", test_stream_block_pool);
     }
 
     return suite;
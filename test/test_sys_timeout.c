@@ -273,6 +273,264 @@ static void test_timeout_clear(void)
     return;
 }
 
+static uint32_t fired_at[4];
+
+static void test_fire_stamp(int drop, void *param)
+{
+    uint32_t *stamp = (uint32_t *) param;
+
+    if (!drop) {
+        *stamp = _cupkee_systicks;
+    }
+}
+
+static void test_idle(void)
+{
+    cupkee_timeout_t *t1, *t2;
+    int loops;
+
+    _cupkee_systicks = 0;
+    memset(fired_at, 0, sizeof(fired_at));
+
+    CU_ASSERT(cupkee_timeout_next(0) == CUPKEE_TICKS_FOREVER);
+
+    CU_ASSERT_FATAL((t1 = cupkee_timeout_register(50, 0, test_fire_stamp, &fired_at[0])) != NULL);
+    CU_ASSERT_FATAL((t2 = cupkee_timeout_register(120, 1, test_fire_stamp, &fired_at[1])) != NULL);
+    CU_ASSERT(cupkee_timeout_next(0) == 50);
+    CU_ASSERT(cupkee_timeout_next(20) == 30);
+    CU_ASSERT(cupkee_timeout_next(50) == 0);
+
+    // Main loop: sleep till next deadline whenever nothing to do
+    for (loops = 0; loops < 16 && fired_at[1] < 240; loops++) {
+        if (!cupkee_event_poll()) {
+            cupkee_idle();
+        }
+    }
+
+    CU_ASSERT(fired_at[0] == 50);
+    CU_ASSERT(fired_at[1] == 240);
+    CU_ASSERT(hw_mock_idle_count() == 3);
+    CU_ASSERT(hw_mock_idle_until() == 240);
+
+    // Pending event keep the loop awake
+    cupkee_event_post_systick();
+    cupkee_idle();
+    CU_ASSERT(hw_mock_idle_count() == 3);
+    cupkee_event_poll();
+
+    cupkee_timeout_unregister(t2);
+    cupkee_event_poll();
+}
+
+static void test_clear_self(int drop, void *param)
+{
+    int *pv = (int *) param;
+
+    if (drop) {
+        pv[1] += 1;
+    } else {
+        pv[0] += 1;
+        cupkee_timeout_clear_with_id(pv[2]);
+    }
+}
+
+static void test_wheel(void)
+{
+    static const uint32_t waits[] = {1, 31, 32, 1025, 40000, (1 << 20) + 100};
+    cupkee_timeout_t *t;
+    int self[3] = {0, 0, 0};
+    unsigned i;
+
+    _cupkee_systicks = 0;
+    memset(fired_at, 0, sizeof(fired_at));
+
+    // Expire in each level of wheel, and beyond
+    for (i = 0; i < sizeof(waits) / sizeof(waits[0]); i++) {
+        uint32_t stamp = 0;
+
+        CU_ASSERT_FATAL(cupkee_timeout_register(waits[i], 0, test_fire_stamp, &stamp) != NULL);
+        CU_ASSERT(cupkee_timeout_next(0) == waits[i]);
+        while (!stamp && _cupkee_systicks < waits[i] * 2) {
+            cupkee_timeout_sync(++_cupkee_systicks);
+        }
+        CU_ASSERT(stamp == waits[i]);
+        _cupkee_systicks = 0;
+    }
+
+    // Ticks skipped, as in idle
+    CU_ASSERT_FATAL(cupkee_timeout_register(3000, 0, test_fire_stamp, &fired_at[0]) != NULL);
+    CU_ASSERT_FATAL(cupkee_timeout_register(7000, 0, test_fire_stamp, &fired_at[1]) != NULL);
+    _cupkee_systicks = 2999;
+    cupkee_timeout_sync(_cupkee_systicks);
+    CU_ASSERT(fired_at[0] == 0);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == 1);
+    _cupkee_systicks = 5000;
+    cupkee_timeout_sync(_cupkee_systicks);
+    CU_ASSERT(fired_at[0] == 5000);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == 2000);
+    _cupkee_systicks = 8000;
+    cupkee_timeout_sync(_cupkee_systicks);
+    CU_ASSERT(fired_at[1] == 8000);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == CUPKEE_TICKS_FOREVER);
+
+    // Repeat timeout clear itself in handler
+    _cupkee_systicks = 0;
+    CU_ASSERT_FATAL((t = cupkee_timeout_register(10, 1, test_clear_self, self)) != NULL);
+    self[2] = t->id;
+    while (_cupkee_systicks < 100) {
+        cupkee_timeout_sync(++_cupkee_systicks);
+    }
+    CU_ASSERT(self[0] == 1 && self[1] == 1);
+    CU_ASSERT(cupkee_timeout_clear_all() == 0);
+}
+
+static void test_id_index(void)
+{
+    cupkee_timeout_t *t;
+    int counter[2] = {0, 0};
+    int first, i;
+
+    _cupkee_systicks = 0;
+
+    // Unregister after expired is nothing
+    CU_ASSERT_FATAL((t = cupkee_timeout_register(5, 0, test_handle, counter)) != NULL);
+    while (_cupkee_systicks < 10) {
+        cupkee_timeout_sync(++_cupkee_systicks);
+    }
+    CU_ASSERT(counter[0] == 1 && counter[1] == 1);
+    cupkee_timeout_unregister(t);
+    CU_ASSERT(counter[0] == 1 && counter[1] == 1);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == CUPKEE_TICKS_FOREVER);
+
+    // Index grown as timeouts increase, each found by id
+    counter[1] = 0;
+    first = -1;
+    for (i = 0; i < 200; i++) {
+        CU_ASSERT_FATAL((t = cupkee_timeout_register(1000, 1, test_handle, counter)) != NULL);
+        if (first < 0) {
+            first = t->id;
+        }
+    }
+    for (i = 0; i < 200; i += 2) {
+        CU_ASSERT(1 == cupkee_timeout_clear_with_id(first + i));
+    }
+    CU_ASSERT(0 == cupkee_timeout_clear_with_id(first));
+    CU_ASSERT(counter[1] == 100);
+
+    cupkee_timeout_unregister(t);
+    CU_ASSERT(counter[1] == 101);
+    CU_ASSERT(cupkee_timeout_clear_all() == 99);
+}
+
+static int clear_ids[10];
+static int clear_registered;
+
+static void test_clear_handle(int drop, void *param)
+{
+    int *pv = (int *) param;
+    int i;
+
+    if (drop) {
+        pv[1] += 1;
+        // Index grown, peers cleared while clear walks it
+        for (i = 0; i < 20; i++) {
+            if (cupkee_timeout_register(1000, 1, test_handle, pv + 2)) {
+                clear_registered++;
+            }
+        }
+        for (i = 0; i < 10; i++) {
+            cupkee_timeout_clear_with_id(clear_ids[i]);
+        }
+    }
+}
+
+static void test_clear_in_drop(void)
+{
+    int counter[4] = {0, 0, 0, 0};
+    cupkee_timeout_t *t;
+    int i, j;
+
+    _cupkee_systicks = 0;
+    clear_registered = 0;
+
+    // Ids apart by the largest index, to be in one bucket
+    for (i = 0; i < 10; i++) {
+        CU_ASSERT_FATAL((t = cupkee_timeout_register(1000, 1, test_clear_handle, counter)) != NULL);
+        clear_ids[i] = t->id;
+        for (j = 1; j < CUPKEE_TIMEOUT_ID_HASH_MAX; j++) {
+            cupkee_timeout_unregister(cupkee_timeout_register(1000, 0, test_handle, counter + 2));
+        }
+    }
+    counter[3] = 0;
+
+    CU_ASSERT(cupkee_timeout_clear_with_flags(1) == 1);
+    CU_ASSERT(counter[1] == 10);
+    CU_ASSERT(clear_registered == 200);
+    CU_ASSERT(counter[3] == 0);
+
+    // Registered by handler are left, index grown later
+    CU_ASSERT(cupkee_timeout_clear_all() == 200);
+    CU_ASSERT(counter[3] == 200);
+}
+
+static uint32_t missed_sum;
+
+static void test_periodic(int drop, void *param)
+{
+    int *pv = (int *) param;
+
+    if (drop) {
+        pv[1] += 1;
+    } else {
+        pv[0] += 1;
+        missed_sum += cupkee_timeout_missed();
+    }
+}
+
+static void test_overrun(void)
+{
+    cupkee_timeout_t *t;
+
+    CU_ASSERT(cupkee_timeout_missed() == 0);
+
+    // Late sync does not shift the period
+    _cupkee_systicks = 0;
+    v1[0] = 0; v1[1] = 0;
+    missed_sum = 0;
+    CU_ASSERT_FATAL((t = cupkee_timeout_register(10, CUPKEE_FLAG_REPEAT, test_periodic, v1)) != NULL);
+    _cupkee_systicks = 13;
+    cupkee_timeout_sync(_cupkee_systicks);
+    CU_ASSERT(v1[0] == 1 && missed_sum == 0);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == 7);
+
+    // Missed periods skipped and reported
+    _cupkee_systicks = 45;
+    cupkee_timeout_sync(_cupkee_systicks);
+    CU_ASSERT(v1[0] == 2 && missed_sum == 2);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == 5);
+    while (_cupkee_systicks < 100) {
+        cupkee_timeout_sync(++_cupkee_systicks);
+    }
+    CU_ASSERT(v1[0] == 8 && missed_sum == 2);
+    cupkee_timeout_unregister(t);
+
+    // Missed periods run back to back
+    _cupkee_systicks = 0;
+    v2[0] = 0; v2[1] = 0;
+    missed_sum = 0;
+    CU_ASSERT_FATAL((t = cupkee_timeout_register(10, CUPKEE_FLAG_REPEAT | CUPKEE_FLAG_CATCHUP, test_periodic, v2)) != NULL);
+    _cupkee_systicks = 45;
+    cupkee_timeout_sync(_cupkee_systicks);
+    CU_ASSERT(v2[0] == 4 && missed_sum == 3 + 2 + 1);
+    CU_ASSERT(cupkee_timeout_next(_cupkee_systicks) == 5);
+    while (_cupkee_systicks < 100) {
+        cupkee_timeout_sync(++_cupkee_systicks);
+    }
+    CU_ASSERT(v2[0] == 10 && v2[1] == 0);
+    cupkee_timeout_unregister(t);
+    CU_ASSERT(v2[1] == 1);
+}
+
 CU_pSuite test_sys_timeout(void)
 {
     CU_pSuite suite = CU_add_suite("system timeout", test_setup, test_clean);
@@ -282,6 +540,11 @@ CU_pSuite test_sys_timeout(void)
         CU_add_test(suite, "timeout running  ", test_running);
         CU_add_test(suite, "timeout clear1   ", test_self_clear);
         CU_add_test(suite, "timeout clear2   ", test_timeout_clear);
+        CU_add_test(suite, "timeout idle     ", test_idle);
+        CU_add_test(suite, "timeout wheel    ", test_wheel);
+        CU_add_test(suite, "timeout overrun  ", test_overrun);
+        CU_add_test(suite, "timeout id index ", test_id_index);
+        CU_add_test(suite, "timeout clear    ", test_clear_in_drop);
     }
 
     return suite;
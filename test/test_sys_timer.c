@@ -56,13 +56,27 @@ static int test_timer_counter(void *entry, int event, intptr_t param)
 
 static void test_timer_request(void)
 {
+    cupkee_memory_stat_t stat;
+    uint32_t used;
     void *timer;
 
+    cupkee_memory_stats(&stat);
+    used = stat.bytes_used;
+
     CU_ASSERT(0 <= (timer = cupkee_timer_request(test_timer_counter, 0)));
     CU_ASSERT(cupkee_timer_state(timer) == CUPKEE_TIMER_STATE_IDLE);
 
+#if CUPKEE_TIMER_RESERVE
+    // Taken from pool reserved
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(stat.bytes_used == used);
+#endif
+
     CU_ASSERT(0 == cupkee_release(timer));
     CU_ASSERT(timer_event == CUPKEE_EVENT_DESTROY);
+
+    cupkee_memory_stats(&stat);
+    CU_ASSERT(stat.bytes_used == used);
 }
 
 static void test_timer_start(void)